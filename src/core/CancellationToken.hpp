@@ -0,0 +1,55 @@
+#ifndef CANCELLATIONTOKEN_HPP
+#define CANCELLATIONTOKEN_HPP
+
+#include "Globals.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief A flag which asks a running stage to stop.
+	///
+	/// Long-running algorithms check the token at safe points
+	/// (between lines, buckets or batches) and return early
+	/// when it is set. A cancelled stage leaves its results
+	/// unfinished, so callers must discard them.
+	///
+	class CancellationToken
+	{
+		private:
+
+			std::atomic<bool> cancelled;
+
+		public:
+
+			CancellationToken()
+				:
+				  cancelled(false)
+			{}
+
+			/// A token which is never cancelled
+			static inline const CancellationToken& none()
+			{
+				static const CancellationToken token;
+				return token;
+			}
+
+			/// Ask the stage to stop (may be called from any thread)
+			inline void cancel()
+			{
+				cancelled.store(true, std::memory_order_relaxed);
+			}
+
+			/// Clear the flag before starting a new stage
+			inline void reset()
+			{
+				cancelled.store(false, std::memory_order_relaxed);
+			}
+
+			inline bool is_cancelled() const
+			{
+				return cancelled.load(std::memory_order_relaxed);
+			}
+	};
+}
+
+#endif // CANCELLATIONTOKEN_HPP
@@ -2,11 +2,18 @@
 #define CONFIG_HPP
 
 #include "Globals.hpp"
+#include "Options.hpp"
+#include <QDialog>
+#include <QCloseEvent>
+#include <QListWidgetItem>
 
 namespace Morpheus
 {
-
-	class Config : public QDialog
+	///
+	/// \brief The settings dialog. The options themselves
+	/// are inherited from Options.
+	///
+	class Config : public QDialog, public Options
 	{
 			Q_OBJECT
 
@@ -22,32 +29,10 @@ namespace Morpheus
 			static QSize main_window_size;
 			static QPoint main_window_pos;
 
-			static bool confirm_on_exit;
-			static bool console_output;
-
-			static uint max_lines;
-			static uint lines_to_process_together;
-
-			/// Preprocessing options
-			static bool proc_lowercase;
-			static bool proc_remove_all_spaces;
-			static bool proc_remove_non_alnum;
-			static bool proc_remove_punctuation;
-			static bool proc_collapse_multiple_spaces;
-			static bool proc_keep_apostrophes;
-
-			/// Options to dump the processed data into various files
-			static bool remember_last_open_dir;
-			static QString last_open_dir;
-			static bool autosave_stats;
-			static bool seg_method_ps_count;
-			static bool seg_method_ps_entropy;
-			static bool seg_method_character_frequencies;
-
-			/// Semantics
-			static uint hidden_layer_size;
-
+			/// Read the widgets and save the options
 			void save();
+
+			/// Load the options and update the widgets
 			void load();
 
 		signals:
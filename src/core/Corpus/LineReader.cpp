@@ -0,0 +1,235 @@
+#include "LineReader.hpp"
+#include <QTextCodec>
+
+namespace Morpheus
+{
+	constexpr qint64 LineReader::max_line_size;
+
+	bool LineReader::open(const QString& _file_name,
+						  QString& _error)
+	{
+		close();
+
+		file.setFileName(_file_name);
+		if (!file.open(QIODevice::ReadOnly))
+		{
+			_error = file.errorString();
+			return false;
+		}
+
+		/// An empty file cannot be mapped
+		static const char nothing(0);
+		const qint64 file_size(file.size());
+		const char* data(&nothing);
+		if (file_size > 0)
+		{
+			data = reinterpret_cast<const char*>(file.map(0, file_size));
+			if (data == nullptr)
+			{
+				_error = file.errorString();
+				file.close();
+				return false;
+			}
+		}
+
+		begin = data;
+		end = data + file_size;
+
+		if (file_size >= 3
+			&& std::memcmp(begin, "\xEF\xBB\xBF", 3) == 0)
+		{
+			/// UTF-8 byte order mark
+			begin += 3;
+		}
+		else if (file_size >= 2
+				 && (std::memcmp(begin, "\xFF\xFE", 2) == 0
+					 || std::memcmp(begin, "\xFE\xFF", 2) == 0
+					 || (file_size >= 4 && std::memcmp(begin, "\x00\x00\xFE\xFF", 4) == 0)))
+		{
+			/// UTF-16 or UTF-32 (detected from the byte order mark).
+			/// The conversion goes through a QByteArray and a QString, and
+			/// UTF-16 can take up to half as many bytes again in UTF-8.
+			if (file_size > std::numeric_limits<int>::max() / 3 * 2)
+			{
+				_error = "The file is too large to be converted from UTF-16 or UTF-32 ("
+						 + QString::number(file_size) + " bytes)";
+				close();
+				return false;
+			}
+
+			const QByteArray bytes(QByteArray::fromRawData(begin, static_cast<int>(file_size)));
+			converted = QTextCodec::codecForUtfText(bytes)->toUnicode(bytes).toUtf8();
+			file.close();
+			begin = converted.constData();
+			end = begin + converted.size();
+		}
+
+		/// Only a file larger than max_line_size can have a line which is too long
+		if (end - begin > max_line_size)
+		{
+			const char* line(find_long_line(begin, end));
+			if (line != end)
+			{
+				_error = "A line at byte " + QString::number(static_cast<qint64>(line - begin))
+						 + " is longer than " + QString::number(max_line_size) + " bytes";
+				close();
+				return false;
+			}
+		}
+
+		next = begin;
+		invalid = validate_utf8(begin, end);
+		return true;
+	}
+
+	void LineReader::close()
+	{
+		/// Closing the file also unmaps it
+		file.close();
+		converted.clear();
+		begin = nullptr;
+		end = nullptr;
+		next = nullptr;
+		invalid = nullptr;
+	}
+
+	const char* LineReader::validate_utf8(const char* _begin,
+										  const char* _end)
+	{
+		const uchar* pos(reinterpret_cast<const uchar*>(_begin));
+		const uchar* end(reinterpret_cast<const uchar*>(_end));
+
+		while (pos < end)
+		{
+			/// Skip ASCII eight bytes at a time
+			while (end - pos >= 8)
+			{
+				quint64 word;
+				std::memcpy(&word, pos, sizeof(word));
+				if ((word & 0x8080808080808080ULL) != 0)
+				{
+					break;
+				}
+				pos += 8;
+			}
+
+			if (pos == end)
+			{
+				break;
+			}
+
+			const uchar lead(*pos);
+			if (lead < 0x80)
+			{
+				++pos;
+				continue;
+			}
+
+			/// The length of the sequence and the range of its second byte
+			/// (which excludes overlong forms, surrogates and code points above U+10FFFF)
+			int length(0);
+			uchar min(0x80);
+			uchar max(0xBF);
+			if (lead >= 0xC2 && lead <= 0xDF)
+			{
+				length = 2;
+			}
+			else if (lead >= 0xE0 && lead <= 0xEF)
+			{
+				length = 3;
+				min = (lead == 0xE0 ? 0xA0 : 0x80);
+				max = (lead == 0xED ? 0x9F : 0xBF);
+			}
+			else if (lead >= 0xF0 && lead <= 0xF4)
+			{
+				length = 4;
+				min = (lead == 0xF0 ? 0x90 : 0x80);
+				max = (lead == 0xF4 ? 0x8F : 0xBF);
+			}
+			else
+			{
+				return reinterpret_cast<const char*>(pos);
+			}
+
+			if (end - pos < length
+				|| pos[1] < min
+				|| pos[1] > max)
+			{
+				return reinterpret_cast<const char*>(pos);
+			}
+
+			for (int i = 2; i < length; ++i)
+			{
+				if ((pos[i] & 0xC0) != 0x80)
+				{
+					return reinterpret_cast<const char*>(pos);
+				}
+			}
+
+			pos += length;
+		}
+
+		return _end;
+	}
+
+	const char* LineReader::find_long_line(const char* _begin,
+										   const char* _end)
+	{
+		const char* pos(_begin);
+		while (_end - pos > max_line_size)
+		{
+			const char* eol(static_cast<const char*>(std::memchr(pos, '\n', max_line_size + 1)));
+			if (eol == nullptr)
+			{
+				return pos;
+			}
+			pos = eol + 1;
+		}
+		return _end;
+	}
+
+	void LineReader::decode(const Line& _line,
+							QString& _string) const
+	{
+		if (_line.data + _line.size > invalid)
+		{
+			_string = QString::fromUtf8(_line.data, static_cast<int>(_line.size));
+			return;
+		}
+
+		/// A line never has more UTF-16 code units than bytes
+		_string.resize(static_cast<int>(_line.size));
+		QChar* out(_string.data());
+		const uchar* pos(reinterpret_cast<const uchar*>(_line.data));
+		const uchar* end(pos + _line.size);
+
+		while (pos < end)
+		{
+			const uchar lead(*pos);
+			if (lead < 0x80)
+			{
+				*out++ = QChar(lead);
+				++pos;
+			}
+			else if (lead < 0xE0)
+			{
+				*out++ = QChar(static_cast<ushort>(((lead & 0x1F) << 6) | (pos[1] & 0x3F)));
+				pos += 2;
+			}
+			else if (lead < 0xF0)
+			{
+				*out++ = QChar(static_cast<ushort>(((lead & 0x0F) << 12) | ((pos[1] & 0x3F) << 6) | (pos[2] & 0x3F)));
+				pos += 3;
+			}
+			else
+			{
+				const uint cp(((lead & 0x07) << 18) | ((pos[1] & 0x3F) << 12) | ((pos[2] & 0x3F) << 6) | (pos[3] & 0x3F));
+				*out++ = QChar(QChar::highSurrogate(cp));
+				*out++ = QChar(QChar::lowSurrogate(cp));
+				pos += 4;
+			}
+		}
+
+		_string.resize(static_cast<int>(out - _string.constData()));
+	}
+}
@@ -0,0 +1,219 @@
+#ifndef LINEREADER_HPP
+#define LINEREADER_HPP
+
+#include "Globals.hpp"
+#include <cstring>
+
+namespace Morpheus
+{
+	///
+	/// \brief Reads the lines of a UTF-8 text file from a memory-mapped copy.
+	///
+	/// Line breaks are found with memchr(), and the lines are returned
+	/// as views into the file (Line), so nothing is copied unless a line
+	/// is decoded into a QString with decode(). The whole file is checked
+	/// for valid UTF-8 when it is opened (mostly eight ASCII bytes at a time),
+	/// so the lines up to the first invalid byte are decoded without any
+	/// further checks. Lines after it are decoded by QString::fromUtf8(),
+	/// which replaces the invalid sequences like QTextStream does.
+	///
+	/// A UTF-8 byte order mark is skipped, and a file with a UTF-16 or
+	/// UTF-32 byte order mark is converted to UTF-8 in memory first.
+	/// Like QTextStream::readLine(), the lines do not include
+	/// the trailing "\n" or "\r\n". A file with a line longer than
+	/// max_line_size bytes cannot be opened, since the line might not
+	/// fit in a QString.
+	///
+	class LineReader
+	{
+		public:
+
+			/// A line in the file (not terminated by \0)
+			struct Line
+			{
+					const char* data;
+					qint64 size;
+			};
+
+			/// The longest line which can be decoded
+			static constexpr qint64 max_line_size = std::numeric_limits<int>::max();
+
+		private:
+
+			Q_DISABLE_COPY(LineReader)
+
+			QFile file;
+
+			/// The file converted to UTF-8 if it was in another encoding
+			QByteArray converted;
+
+			const char* begin;
+			const char* end;
+
+			/// The start of the next line
+			const char* next;
+
+			/// The first byte which is not valid UTF-8 (end if there is none)
+			const char* invalid;
+
+			///
+			/// \brief Find the first byte which is not part of valid UTF-8
+			/// \param _begin
+			/// \param _end
+			/// \return _end if the whole range is valid
+			///
+			static const char* validate_utf8(const char* _begin,
+											 const char* _end);
+
+			///
+			/// \brief Find the first line longer than max_line_size bytes
+			/// \param _begin
+			/// \param _end
+			/// \return _end if there is none
+			///
+			static const char* find_long_line(const char* _begin,
+											  const char* _end);
+
+		public:
+
+			LineReader()
+				:
+				  begin(nullptr),
+				  end(nullptr),
+				  next(nullptr),
+				  invalid(nullptr)
+			{}
+
+			///
+			/// \brief Map a file into memory
+			/// \param _file_name
+			/// \param _error: receives the reason for a failure
+			/// \return Whether the file could be read
+			///
+			bool open(const QString& _file_name,
+					  QString& _error);
+
+			/// Unmap the file
+			void close();
+
+			///
+			/// \brief Split the first line off a range of the file
+			/// \param _pos: the start of the range (moved past the line break)
+			/// \param _end: the end of the range
+			/// \param _line
+			/// \return false if the range is empty
+			///
+			static inline bool next_line(const char*& _pos,
+										 const char* _end,
+										 Line& _line)
+			{
+				if (_pos == _end)
+				{
+					return false;
+				}
+
+				const char* eol(static_cast<const char*>(std::memchr(_pos, '\n', _end - _pos)));
+				const char* line_end(eol == nullptr ? _end : eol);
+				_line.data = _pos;
+				_line.size = line_end - _pos;
+				if (_line.size > 0
+					&& line_end[-1] == '\r')
+				{
+					--_line.size;
+				}
+				_pos = (eol == nullptr ? _end : eol + 1);
+				return true;
+			}
+
+			///
+			/// \brief Return the next line
+			/// \param _line: points into the file until it is closed
+			/// \return false at the end of the file
+			///
+			inline bool read_line(Line& _line)
+			{
+				return next_line(next, end, _line);
+			}
+
+			///
+			/// \brief Return the next block of whole lines, which can be
+			/// split with next_line(), possibly on another thread
+			/// \param _block: at least _size bytes unless the end of the file is reached
+			/// \param _size
+			/// \return false at the end of the file
+			///
+			inline bool read_block(Line& _block,
+								   const qint64 _size)
+			{
+				if (next == end)
+				{
+					return false;
+				}
+
+				const char* block_end(end);
+				if (end - next > _size)
+				{
+					const char* eol(static_cast<const char*>(std::memchr(next + _size, '\n', end - next - _size)));
+					block_end = (eol == nullptr ? end : eol + 1);
+				}
+				_block.data = next;
+				_block.size = block_end - next;
+				next = block_end;
+				return true;
+			}
+
+			///
+			/// \brief Return the next line decoded into _line.
+			/// The memory of _line is reused, so reading into the same
+			/// string over and over does not allocate once it is long enough.
+			/// \param _line
+			/// \return false at the end of the file
+			///
+			inline bool read_line(QString& _line)
+			{
+				Line line;
+				if (!read_line(line))
+				{
+					return false;
+				}
+				decode(line, _line);
+				return true;
+			}
+
+			///
+			/// \brief Decode a line returned by read_line() or next_line()
+			/// (safe to call from several threads)
+			/// \param _line
+			/// \param _string
+			///
+			void decode(const Line& _line,
+						QString& _string) const;
+
+			///
+			/// \brief The UTF-8 contents of the file (without a byte order mark)
+			///
+			inline const char* data() const
+			{
+				return begin;
+			}
+
+			inline qint64 size() const
+			{
+				return end - begin;
+			}
+
+			/// The number of bytes read so far
+			inline qint64 pos() const
+			{
+				return next - begin;
+			}
+
+			/// Whether the whole file is valid UTF-8
+			inline bool is_valid() const
+			{
+				return invalid == end;
+			}
+	};
+}
+
+#endif // LINEREADER_HPP
@@ -0,0 +1,177 @@
+#include "Preprocessor.hpp"
+#include <mutex>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Morpheus
+{
+	Preprocessor::Preprocessor()
+		:
+		  table(compile()),
+		  collapse(Options::proc_collapse_multiple_spaces),
+		  lowercase(Options::proc_lowercase)
+	{}
+
+	sptr<const Preprocessor::Table> Preprocessor::compile()
+	{
+		/// One table per combination of the options which affect it
+		static std::mutex mutex;
+		static std::map<uint, sptr<const Table>> tables;
+
+		const uint key((Options::proc_lowercase ? 1 : 0)
+					   | (Options::proc_remove_all_spaces ? 2 : 0)
+					   | (Options::proc_remove_non_alnum ? 4 : 0)
+					   | (Options::proc_remove_punctuation ? 8 : 0)
+					   | (Options::proc_keep_apostrophes ? 16 : 0));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		sptr<const Table>& compiled(tables[key]);
+		if (!compiled)
+		{
+			/// Each entry holds whatever the character-by-character
+			/// rules produce, so the output does not change
+			sptr<Table> actions(std::make_shared<Table>(0x10000));
+			for (uint ch = 0; ch < actions->size(); ++ch)
+			{
+				QChar out[2];
+				const int count(process_char(QChar(static_cast<ushort>(ch)), out));
+				Action& action((*actions)[ch]);
+				action.ch = (count > 0 ? out[count - 1].unicode() : 0);
+				action.count = static_cast<uchar>(count);
+				action.space = (count > 0 && out[count - 1].isSpace());
+			}
+			compiled = actions;
+		}
+		return compiled;
+	}
+
+	template<bool Collapse>
+	QChar* Preprocessor::apply(const ushort* _in,
+							   const ushort* _end,
+							   QChar* _out) const
+	{
+		const Action* actions(table->data());
+		QChar* const begin(_out);
+
+		/// A run of white space which has been read but not written
+		bool space(false);
+
+#ifdef __SSE2__
+		const __m128i zero(_mm_setzero_si128());
+		const __m128i lower_a(_mm_set1_epi16('a'));
+		const __m128i upper_a(_mm_set1_epi16('A'));
+		const __m128i digit_0(_mm_set1_epi16('0'));
+		const __m128i letters(_mm_set1_epi16(25));
+		const __m128i digits(_mm_set1_epi16(9));
+		const __m128i to_lower(_mm_set1_epi16(lowercase ? 0x20 : 0));
+#endif
+
+		for (; _in < _end; ++_in)
+		{
+#ifdef __SSE2__
+			/// ASCII letters and digits are written as they are under all
+			/// options (except that capitals are lowercased), so runs of them
+			/// are classified and copied eight code units at a time
+			while (_end - _in >= 8)
+			{
+				const __m128i chars(_mm_loadu_si128(reinterpret_cast<const __m128i*>(_in)));
+
+				/// first <= x <= first + range, as an unsigned saturating subtraction giving 0
+				auto in_range = [&](const __m128i& _first, const __m128i& _range)
+				{
+					return _mm_cmpeq_epi16(_mm_subs_epu16(_mm_sub_epi16(chars, _first), _range), zero);
+				};
+
+				const __m128i upper(in_range(upper_a, letters));
+				const __m128i alnum(_mm_or_si128(_mm_or_si128(in_range(lower_a, letters), in_range(digit_0, digits)), upper));
+
+				/// The number of letters and digits before anything else
+				const int mask(_mm_movemask_epi8(alnum));
+				int run(0);
+				while (run < 8
+					   && ((mask >> (2 * run)) & 1) != 0)
+				{
+					++run;
+				}
+
+				if (run == 0)
+				{
+					break;
+				}
+
+				if (Collapse
+					&& space)
+				{
+					*_out++ = ' ';
+					space = false;
+				}
+
+				/// All eight are stored (the output has room for twice the input),
+				/// and anything after the run is overwritten
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(_out), _mm_add_epi16(chars, _mm_and_si128(upper, to_lower)));
+				_out += run;
+				_in += run;
+
+				if (run < 8)
+				{
+					break;
+				}
+			}
+
+			if (_in == _end)
+			{
+				break;
+			}
+#endif
+
+			const Action& action(actions[*_in]);
+			if (Collapse)
+			{
+				/// Runs of white space become a single space,
+				/// and those at the ends of the line are removed
+				/// (like QString::simplified())
+				if (action.count == 0)
+				{
+					continue;
+				}
+
+				if (action.space)
+				{
+					space = (_out != begin);
+					continue;
+				}
+
+				if (space)
+				{
+					*_out++ = ' ';
+					space = false;
+				}
+			}
+
+			/// Both slots are written and the output is moved by the count,
+			/// which keeps the loop free of branches
+			_out[0] = QChar(action.ch);
+			_out[1] = QChar(action.ch);
+			_out += action.count;
+		}
+
+		return _out;
+	}
+
+	QString Preprocessor::process_line(const QString& _line) const
+	{
+		/// A character is written at most twice
+		QString processed_line;
+		processed_line.resize(2 * _line.size());
+
+		const ushort* in(reinterpret_cast<const ushort*>(_line.constData()));
+		const ushort* end(in + _line.size());
+		QChar* out(collapse ? apply<true>(in, end, processed_line.data())
+							: apply<false>(in, end, processed_line.data()));
+
+		processed_line.resize(static_cast<int>(out - processed_line.constData()));
+		return processed_line;
+	}
+}
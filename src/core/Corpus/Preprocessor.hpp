@@ -0,0 +1,122 @@
+#ifndef PREPROCESSOR_HPP
+#define PREPROCESSOR_HPP
+
+#include "Globals.hpp"
+#include "Options.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief Preprocessing of corpus lines (removal of spaces,
+	/// punctuation, etc.) according to the preprocessing options.
+	///
+	/// The options are compiled into a table with the output for each of
+	/// the 64K UTF-16 code units (see compile()), so a line is processed
+	/// in a single pass with one lookup per character. Collapsing multiple
+	/// spaces is done in the same pass. Tables are shared by all
+	/// preprocessors created with the same options.
+	///
+	/// ASCII letters and digits are never removed, so with SSE2 runs of
+	/// them are detected, lowercased and copied eight code units at a time,
+	/// and only the other characters are looked up in the table.
+	///
+	class Preprocessor
+	{
+		private:
+
+			/// What is written for a code unit
+			struct Action
+			{
+					/// The character after lowercasing
+					ushort ch;
+
+					/// How many times it is written (0 if it is removed)
+					uchar count;
+
+					/// Whether the character is white space (for collapsing)
+					bool space;
+			};
+
+			using Table = std::vector<Action>;
+
+			/// The table for the options at the time of construction
+			sptr<const Table> table;
+
+			/// Options::proc_collapse_multiple_spaces
+			bool collapse;
+
+			/// Options::proc_lowercase (for the SSE2 path)
+			bool lowercase;
+
+			///
+			/// \brief Return the table for the current options,
+			/// building it on first use
+			/// \return
+			///
+			static sptr<const Table> compile();
+
+			///
+			/// \brief Process a range of code units
+			/// \param _in
+			/// \param _end
+			/// \param _out: room for twice as many characters as the input
+			/// \return The end of the output
+			///
+			template<bool Collapse>
+			QChar* apply(const ushort* _in,
+						 const ushort* _end,
+						 QChar* _out) const;
+
+			///
+			/// \brief Process a single character using its Unicode properties
+			/// \param _ch
+			/// \param _out: receives the output (up to two characters)
+			/// \return The number of characters written
+			///
+			static inline int process_char(const QChar _ch,
+										   QChar* _out)
+			{
+				int count(0);
+				if ((_ch.isSpace()
+					 && Options::proc_remove_all_spaces
+					 )
+					|| (!_ch.isLetterOrNumber()
+						&& Options::proc_remove_non_alnum
+						)
+					|| (_ch.isPunct()
+						&& Options::proc_remove_punctuation
+						)
+					)
+				{
+					if (_ch == '\''
+						&& Options::proc_keep_apostrophes)
+					{
+						_out[count++] = '\'';
+					}
+					else
+					{
+						return count;
+					}
+				}
+
+				_out[count++] = (Options::proc_lowercase) ? _ch.toLower() : _ch;
+				return count;
+			}
+
+		public:
+
+			///
+			/// \brief Use the current preprocessing options
+			///
+			Preprocessor();
+
+			///
+			/// \brief Preprocess a line
+			/// \param _line
+			/// \return The processed line (empty if nothing is left)
+			///
+			QString process_line(const QString& _line) const;
+	};
+}
+
+#endif // PREPROCESSOR_HPP
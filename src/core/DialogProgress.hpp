@@ -0,0 +1,106 @@
+#ifndef DIALOGPROGRESS_HPP
+#define DIALOGPROGRESS_HPP
+
+#include "Globals.hpp"
+#include "ProgressSink.hpp"
+#include <QProgressDialog>
+
+namespace Morpheus
+{
+	///
+	/// \brief Shows progress reports in a modal dialog with a Cancel button.
+	/// The dialog is opened by start() on the GUI thread, while the reports
+	/// may come from the thread which runs the stage: they are posted to the
+	/// event loop of the dialog, which the throttling in ProgressSink keeps
+	/// to a few times per second. finish() hides the dialog.
+	///
+	class DialogProgress : public ProgressSink
+	{
+		private:
+
+			QWidget* parent;
+
+			uptr<QProgressDialog> dialog;
+
+			/// Called when the Cancel button is pressed
+			std::function<void()> on_cancel;
+
+			/// Run a function on the thread of the dialog
+			template<typename F>
+			inline void post(F&& _f)
+			{
+				if (dialog)
+				{
+					QMetaObject::invokeMethod(dialog.get(), std::forward<F>(_f), Qt::QueuedConnection);
+				}
+			}
+
+		protected:
+
+			void show(const QString& _stage,
+					  const uint _done,
+					  const uint _total) override
+			{
+				post([this, _stage, _done, _total]
+				{
+					/// Reports which arrive after Cancel was pressed are dropped
+					if (!dialog->wasCanceled())
+					{
+						dialog->setLabelText(_stage);
+						dialog->setMaximum(_total);
+						dialog->setValue(_done);
+					}
+				});
+			}
+
+			void close() override
+			{
+				post([this]
+				{
+					dialog->hide();
+				});
+			}
+
+		public:
+
+			///
+			/// \param _parent: the window which the dialog blocks
+			///
+			DialogProgress(QWidget* _parent = nullptr)
+				:
+				  parent(_parent)
+			{}
+
+			///
+			/// \brief Open the dialog before a stage is started.
+			/// Must be called on the GUI thread.
+			/// \param _on_cancel: called on the GUI thread when the Cancel button is pressed
+			///
+			void start(const std::function<void()>& _on_cancel)
+			{
+				if (!dialog)
+				{
+					dialog = std::make_unique<QProgressDialog>(parent);
+					dialog->setMinimum(0);
+					dialog->setWindowModality(Qt::WindowModal);
+					dialog->setAutoClose(false);
+					dialog->setAutoReset(false);
+					QObject::connect(dialog.get(), &QProgressDialog::canceled, [this]
+					{
+						if (on_cancel)
+						{
+							on_cancel();
+						}
+					});
+				}
+
+				on_cancel = _on_cancel;
+				dialog->reset();
+				dialog->setLabelText("");
+				dialog->setMaximum(0);
+				dialog->open();
+			}
+	};
+}
+
+#endif // DIALOGPROGRESS_HPP
@@ -10,18 +10,22 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <fstream>
 #include <sstream>
 #include <chrono>
 #include <utility>
 #include <cmath>
+#include <limits>
+#include <thread>
+#include <atomic>
+#include <functional>
 
-/// Qt
-#include <QApplication>
+/// Qt (core only: widgets are included by the GUI classes)
+#include <QCoreApplication>
 #include <QObject>
 #include <QSettings>
-#include <QCloseEvent>
 
 #include <QSet>
 #include <QHash>
@@ -30,19 +34,13 @@
 #include <QPair>
 
 #include <QFile>
+#include <QSaveFile>
 #include <QFileInfo>
-#include <QFileDialog>
+#include <QDir>
 #include <QTextStream>
 
 #include <QString>
-
-#include <QLabel>
-#include <QProgressDialog>
-#include <QMessageBox>
-#include <QDialog>
-#include <QListWidgetItem>
-
-#include <QSortFilterProxyModel>
+#include <QStringView>
 
 /// Dependencies
 #include "pugixml.hpp"
@@ -80,6 +78,13 @@ namespace Morpheus
 	typedef unsigned long int ulong;
 	typedef unsigned long long int ullong;
 
+	/// QString::SkipEmptyParts is deprecated since Qt 5.14
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+	const Qt::SplitBehavior skip_empty_parts(Qt::SkipEmptyParts);
+#else
+	const QString::SplitBehavior skip_empty_parts(QString::SkipEmptyParts);
+#endif
+
 	inline void pause()
 	{
 		static char ch('a');
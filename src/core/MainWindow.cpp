@@ -6,7 +6,8 @@ namespace Morpheus
 	MainWindow::MainWindow(QWidget* _parent)
 		:
 		  QMainWindow(_parent),
-		  main_window(std::make_unique<Ui::MainWindow>())
+		  main_window(std::make_unique<Ui::MainWindow>()),
+		  progress(this)
 	{
 		QCoreApplication::setOrganizationName("Cantordust");
 		QCoreApplication::setApplicationName("Morpheus");
@@ -16,6 +17,10 @@ namespace Morpheus
 		/// Morpheme extractor
 		morpheme_extractor = std::make_unique<MorphemeExtractor>();
 
+		/// Processing stages
+		pipeline = std::make_unique<Pipeline>(*morpheme_extractor);
+		pipeline->set_progress(progress);
+
 		character_model = std::make_unique<CharacterModel>(morpheme_extractor.get());
 		character_model_filter = std::make_unique<QSortFilterProxyModel>();
 
@@ -41,6 +46,13 @@ namespace Morpheus
 
 	MainWindow::~MainWindow()
 	{
+		if (job.joinable())
+		{
+			pipeline->cancel();
+			job.join();
+			pipeline->discard();
+		}
+
 		if (Config::autosave_stats)
 		{
 			save_stats();
@@ -76,28 +88,20 @@ namespace Morpheus
 
 	void MainWindow::set_filenames(const QString& _file_name)
 	{
-		input_file.setFileName(_file_name);
-		if (input_file.exists())
+		if (pipeline->set_input(_file_name))
 		{
-			QFileInfo fi(input_file);
+			QFileInfo fi(_file_name);
 			if (Config::remember_last_open_dir)
 			{
 				Config::last_open_dir = fi.absoluteDir().absolutePath();
 			}
 			config->save();
-			QDir dir(fi.absoluteDir());
-			QString base(fi.baseName());
-			QString ext(fi.completeSuffix());
-			processed_file.setFileName(dir.absolutePath() + "/" + base + "_proc." + ext);
-			segmented_file.setFileName(dir.absolutePath() + "/" + base + "_seg." + ext);
-			stats_file.setFileName(dir.absolutePath() + "/" + base + "_stats.xml");
 			load_corpus();
 		}
 		else
 		{
-			main_window->actionExtractMorphemes->setEnabled(false);
-			main_window->actionResegmentMorphemes->setEnabled(false);
-			main_window->actionRunSENSE->setEnabled(false);
+			/// The loaded corpus (if any) is kept
+			update_log("Cannot find " + _file_name);
 			clear_filenames();
 		}
 	}
@@ -130,13 +134,7 @@ namespace Morpheus
 
 	void MainWindow::show_morpheme_table()
 	{
-		morpheme_extractor->dictionary_vector.clear();
-		QHash<QString, uint>::const_iterator morph = morpheme_extractor->get_dictionary().constBegin();
-		while (morph != morpheme_extractor->get_dictionary().constEnd())
-		{
-			morpheme_extractor->dictionary_vector.push_back(QPair<QString,uint>(morph.key(),morph.value()));
-			++morph;
-		}
+		morpheme_extractor->dictionary_vector = morpheme_extractor->get_dictionary().by_frequency();
 
 		morpheme_model_filter->setSourceModel(morpheme_model.get());
 		main_window->tblMorphemes->setModel(morpheme_model_filter.get());
@@ -170,79 +168,25 @@ namespace Morpheus
 
 	void MainWindow::save_stats()
 	{
-		if (stats_file.open(QFile::WriteOnly | QFile::Truncate))
-		{
-			stats_file.close();
-			pugi::xml_document stats;
-			pugi::xml_parse_result result = stats.load_file(stats_file.fileName().toUtf8().constData());
-			if (result)
-			{
-				pugi::xml_node root = stats.root();
-				root.set_name("Statistics");
-				pugi::xml_node parameters = root.append_child("Parameters");
-				std::stringstream ss;
-
-				/// Dump the parameters which were used to extract these stats
-				ss << Config::max_lines;
-				pugi::xml_node parameter = parameters.append_child("max_lines");
-				parameter.set_value(ss.str().c_str());
-				ss.clear();
-
-				ss << Config::proc_lowercase;
-				parameter = parameters.append_child("process_lowercase");
-				parameter.set_value(ss.str().c_str());
-				ss.clear();
-
-				ss << Config::proc_remove_all_spaces;
-				parameter = parameters.append_child("process_remove_spaces");
-				parameter.set_value(ss.str().c_str());
-				ss.clear();
-
-				ss << Config::proc_remove_punctuation;
-				parameter = parameters.append_child("process_remove_punctuation");
-				parameter.set_value(ss.str().c_str());
-				ss.clear();
-
-				ss << Config::proc_collapse_multiple_spaces;
-				parameter = parameters.append_child("process_replace_multiple_spaces");
-				parameter.set_value(ss.str().c_str());
-				ss.clear();
-
-				ss << Config::remember_last_open_dir;
-				parameter = parameters.append_child("remember_last_input_file");
-				parameter.set_value(ss.str().c_str());
-				parameter.append_attribute("file_name").set_value(Config::last_open_dir.toUtf8().constData());
-				ss.clear();
-
-				if (morpheme_extractor->get_alphabet().size() > 0)
-				{
-					pugi::xml_node character_root = root.append_child("characters");
-					pugi::xml_node character_node;
-
-					QHash<QChar, uint>& characters(morpheme_extractor->get_alphabet());
+		pipeline->save_stats();
+	}
 
-					for (const QChar& character : characters.keys())
-					{
-						character_node = character_root.append_child("char");
-						character_node.append_attribute("occurrences").set_value(characters[character]);
-						character_node.set_value(QString(character).toUtf8().constData());
-					}
-				}
+	void MainWindow::save_model()
+	{
+		if (morpheme_extractor->get_dictionary_size() == 0)
+		{
+			update_log("There are no morphemes to save");
+			return;
+		}
 
-				if (morpheme_extractor->get_dictionary().size() > 0)
-				{
-					pugi::xml_node morpheme_root = root.append_child("morphemes");
-					pugi::xml_node morpheme_node;
-					QHash<QString, uint>& morphemes(morpheme_extractor->get_dictionary());
-					for (const QString& morpheme : morphemes.keys())
-					{
-						morpheme_node = morpheme_root.append_child("morpheme");
-						morpheme_node.append_attribute("occurrences").set_value(morphemes[morpheme]);
-						morpheme_node.set_value(morpheme.toUtf8().constData());
-					}
-				}
-			}
-			stats.save_file(stats_file.fileName().toUtf8().constData());
+		QFileInfo fi(pipeline->get_input_file_name());
+		QString file_name = QFileDialog::getSaveFileName(this,
+														 tr("Save morpheme model"),
+														 fi.absoluteDir().absolutePath() + "/" + fi.baseName() + ".mdl",
+														 tr("Morpheme models (*.mdl)"));
+		if (!file_name.isEmpty())
+		{
+			morpheme_extractor->export_model(file_name);
 		}
 	}
 
@@ -267,6 +211,7 @@ namespace Morpheus
 
 		connect(main_window->actionExtractMorphemes,SIGNAL(triggered()),this,SLOT(extract_morphemes()));
 		connect(main_window->actionResegmentMorphemes,SIGNAL(triggered()),this,SLOT(resegment_morphemes()));
+		connect(main_window->actionSaveModel,SIGNAL(triggered()),this,SLOT(save_model()));
 		connect(main_window->actionRunSENSE,SIGNAL(triggered()),sense.get(),SLOT(test()));
 
 		connect(main_window->actionQuit,SIGNAL(triggered()),this,SLOT(close()));
@@ -276,260 +221,125 @@ namespace Morpheus
 		connect(morpheme_extractor.get(), SIGNAL(morpheme_extractor_cleared()), this, SLOT(clear_morphemes()));
 
 		connect(morpheme_extractor.get(), SIGNAL(update_log(const QString&)), this, SLOT(update_log(const QString&)));
+		connect(pipeline.get(), SIGNAL(update_log(const QString&)), this, SLOT(update_log(const QString&)));
 	}
 
-	QString MainWindow::process_line(const QString&& _line)
+	void MainWindow::show_segmented_corpus()
 	{
-		QString processed_line;
-		processed_line.reserve(_line.size());
-
-		for (int i = 0; i < _line.size(); ++i)
+		QFile segmented_file(pipeline->get_segmented_file_name());
+		if (segmented_file.open(QFile::ReadOnly | QFile::Text))
 		{
-			if ((_line.at(i).isSpace()
-				 && Config::proc_remove_all_spaces
-				 )
-				|| (!_line.at(i).isLetterOrNumber()
-					&& Config::proc_remove_non_alnum
-					)
-				|| (_line.at(i).isPunct()
-					&& Config::proc_remove_punctuation
-					)
-				)
-			{
-				if (_line.at(i) == '\''
-					&& Config::proc_keep_apostrophes)
-				{
-					processed_line.push_back('\'');
-				}
-				else
-				{
-					continue;
-				}
-			}
+			QTextStream segmented_qts(&segmented_file);
+			main_window->ptxtSegmentedCorpus->setPlainText(segmented_qts.readAll());
+			segmented_file.close();
+		}
+	}
 
-			processed_line.push_back((Config::proc_lowercase) ? _line.at(i).toLower() : _line.at(i));
+	void MainWindow::run_job(const std::function<bool()>& _stage,
+							 const std::function<void()>& _done)
+	{
+		if (job.joinable())
+		{
+			return;
 		}
 
-		if (Config::proc_collapse_multiple_spaces)
+		job_actions.clear();
+		for (QAction* action : {main_window->actionLoadCorpus,
+								main_window->actionExtractMorphemes,
+								main_window->actionResegmentMorphemes,
+								main_window->actionSaveModel,
+								main_window->actionSettings})
 		{
-			processed_line = processed_line.simplified();
-			if (Config::proc_remove_all_spaces)
-			{
-				processed_line.replace(" ","");
-			}
+			job_actions.emplace_back(action, action->isEnabled());
+			action->setEnabled(false);
 		}
 
-		return processed_line;
+		progress.start([this]
+		{
+			pipeline->cancel();
+		});
+
+		job = std::thread([this, _stage, _done]
+		{
+			const bool ok(_stage());
+			QMetaObject::invokeMethod(this, [this, ok, _done]
+			{
+				finish_job(ok, _done);
+			}, Qt::QueuedConnection);
+		});
 	}
 
-	void MainWindow::load_corpus()
+	void MainWindow::finish_job(const bool _ok,
+								const std::function<void()>& _done)
 	{
-		main_window->lnedtFileName->setText(input_file.fileName());
+		job.join();
 
-		uint l(0);
-		if (input_file.open(QFile::ReadOnly))
+		for (const std::pair<QAction*, bool>& action : job_actions)
 		{
-			QTextStream input_qts(&input_file);
-			input_qts.autoDetectUnicode();
-			QString ln;
-			while (input_qts.readLineInto(&ln))
-			{
-				++l;
-			}
-			input_file.close();
+			action.first->setEnabled(action.second);
 		}
+		job_actions.clear();
 
-		if (input_file.open(QFile::ReadOnly))
+		if (_ok
+			&& pipeline->commit())
+		{
+			_done();
+		}
+		else
 		{
-			QProgressDialog pd;
-			pd.setMinimum(0);
-			pd.setWindowModality(Qt::WindowModal);
-			pd.setCancelButton(0);
-			lines = 0;
-			QTextStream input_qts(&input_file);
-			input_qts.autoDetectUnicode();
-			if (processed_file.open(QFile::WriteOnly | QFile::Truncate))
+			if (pipeline->is_cancelled())
 			{
-				pd.setMaximum(l);
-				pd.setLabelText("Extracting characters...");
-				pd.open();
-				QTextStream processed_qts(&processed_file);
-				processed_qts.autoDetectUnicode();
-				QString line;
-				QString processed_line;
-				while (input_qts.readLineInto(&line))
-				{
-					processed_line = process_line(std::move(line));
-					if (processed_line.size() > 0)
-					{
-						processed_qts << processed_line << '\n';
-						++lines;
-						if (lines % 1000 == 0)
-						{
-							processed_qts.flush();
-							pd.setValue(lines);
-							QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-						}
-					}
-				}
-
-				processed_file.close();
-				pd.close();
-
-				/// Initialise the morpheme extractor, which includes
-				///	creating the suffix array.
-
-				morpheme_extractor->init(processed_file.fileName());
-
-				main_window->actionExtractMorphemes->setEnabled(true);
+				update_log("Cancelled");
 			}
-
-			input_file.close();
+			pipeline->discard();
 		}
 	}
 
+	void MainWindow::load_corpus()
+	{
+		/// Preprocess the corpus and initialise the morpheme extractor,
+		/// which includes creating the suffix array.
+		run_job([this]
+		{
+			return pipeline->load_corpus();
+		},
+		[this]
+		{
+			main_window->lnedtFileName->setText(pipeline->get_input_file_name());
+			main_window->actionExtractMorphemes->setEnabled(true);
+		});
+	}
+
 	void MainWindow::extract_morphemes()
 	{
-		morpheme_extractor->clear(true);
-		main_window->actionLoadCorpus->setEnabled(false);
 		main_window->actionSaveCharacters->setEnabled(false);
 		main_window->actionSaveMorphemes->setEnabled(false);
-		connect(morpheme_extractor.get(), SIGNAL(morphemes_extracted()), this, SLOT(show_morpheme_table()));
 
-		if (processed_file.open(QFile::ReadOnly))
+		run_job([this]
 		{
-			if (segmented_file.open(QFile::ReadWrite | QFile::Truncate | QFile::Text))
-			{
-				QTextStream processed_qts(&processed_file);
-				QString line;
-				uint line_count(0);
-				QProgressDialog pd;
-				pd.setMinimum(0);
-				pd.setWindowModality(Qt::WindowModal);
-				pd.setCancelButton(0);
-				pd.open();
-				QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-
-				QTextStream segmented_qts(&segmented_file);
-				if (Config::max_lines == 0)
-				{
-					pd.setMaximum(lines);
-				}
-				else
-				{
-					pd.setMaximum(Config::max_lines);
-				}
-				pd.setLabelText("Processing line " + QString::number(line_count + 1) + "/" + QString::number(pd.maximum()));
-				pd.setValue(0);
-				QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-
-				while (processed_qts.readLineInto(&line)
-					   && (Config::max_lines == 0
-						   || (Config::max_lines > 0
-							   && line_count < Config::max_lines
-							   )
-						   )
-					   )
-				{
-					++line_count;
-
-					line.push_back('\n');
-					segmented_qts << morpheme_extractor->extract_morphemes(std::move(line)) << endl;
-					//					morpheme_extractor->extract_morphemes(line);
-
-					/// Update the progress bar
-					pd.setLabelText("Processing line " + QString::number(line_count + 1)
-									+ "/" + QString::number(pd.maximum())
-									+ "\nTotal morpheme count: " + QString::number(morpheme_extractor->get_total_morpheme_count())
-									+ "\nDistinct morphemes: " + QString::number(morpheme_extractor->get_dictionary_size()));
-
-					pd.setValue(line_count);
-					QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-				}
-
-				segmented_qts.seek(0);
-				main_window->ptxtSegmentedCorpus->setPlainText(segmented_qts.readAll());
-
-				segmented_file.close();
-				pd.close();
-			}
-			processed_file.close();
-
-			morpheme_extractor->clear();
+			return pipeline->extract_morphemes();
+		},
+		[this]
+		{
+			show_segmented_corpus();
 
 			main_window->actionResegmentMorphemes->setEnabled(true);
 			//			main_window->actionRunSENSE->setEnabled(true);
 
 			show_morpheme_table();
-		}
+		});
 	}
 
 	void MainWindow::resegment_morphemes()
 	{
-		if (segmented_file.open(QFile::ReadOnly))
+		run_job([this]
 		{
-			/// Compute the initial dictionary cost and ntropy
-			morpheme_extractor->init_entropy();
-
-			QStringList reseg_list;
-			QTextStream segmented_qts(&segmented_file);
-			QString line;
-			uint line_count(0);
-			QProgressDialog pd;
-			pd.setMinimum(0);
-			pd.setWindowModality(Qt::WindowModal);
-			pd.setCancelButton(0);
-			pd.open();
-			QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-
-			if (Config::max_lines == 0)
-			{
-				pd.setMaximum(lines);
-			}
-			else
-			{
-				pd.setMaximum(Config::max_lines);
-			}
-			pd.setLabelText("Processing line " + QString::number(line_count + 1) + "/" + QString::number(pd.maximum()));
-			pd.setValue(0);
-			QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-
-			while (segmented_qts.readLineInto(&line))
-			{
-				++line_count;
-
-				reseg_list.append(morpheme_extractor->resegment_morphemes(std::move(line)) + '\n');
-				//					morpheme_extractor->extract_morphemes(line);
-
-				/// Update the progress bar
-				pd.setLabelText("Processing line " + QString::number(line_count + 1)
-								+ "/" + QString::number(pd.maximum())
-								+ "\nTotal morpheme count: " + QString::number(morpheme_extractor->get_total_morpheme_count())
-								+ "\nDistinct morphemes: " + QString::number(morpheme_extractor->get_dictionary_size()));
-
-				pd.setValue(line_count);
-				QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
-			}
-
-			segmented_file.close();
-
-			if (segmented_file.open(QFile::ReadWrite | QFile::Truncate))
-			{
-				segmented_qts.setDevice(&segmented_file);
-				for (const QString& str : reseg_list)
-				{
-					segmented_qts << str;
-				}
-			}
-
-			segmented_qts.seek(0);
-			main_window->ptxtSegmentedCorpus->setPlainText(segmented_qts.readAll());
-
-			segmented_file.close();
-
-			pd.close();
-
+			return pipeline->resegment_morphemes();
+		},
+		[this]
+		{
+			show_segmented_corpus();
 			show_morpheme_table();
-		}
+		});
 	}
 }
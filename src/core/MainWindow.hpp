@@ -4,10 +4,18 @@
 #include "Globals.hpp"
 #include "Config.hpp"
 #include "MorphemeExtractor.hpp"
+#include "Pipeline.hpp"
+#include "DialogProgress.hpp"
 #include "CharacterModel.hpp"
 #include "MorphemeModel.hpp"
 #include "Sense.hpp"
+#include <QApplication>
 #include <QMainWindow>
+#include <QCloseEvent>
+#include <QFileDialog>
+#include <QLabel>
+#include <QMessageBox>
+#include <QSortFilterProxyModel>
 
 namespace Morpheus
 {
@@ -27,23 +35,18 @@ namespace Morpheus
 
 			uptr<MorphemeExtractor> morpheme_extractor;
 
-			/// The input file for processing (the corpus)
-			/// TODO: Multiple files
-			/// TODO: Buffering of large / multiple files
-			QFile input_file;
-
-			/// The processed file
-			QFile processed_file;
+			/// Progress of the running stage
+			DialogProgress progress;
 
-			/// The processed file (file.ext.seg, etc.)
+			/// Processing stages and the files they use
 			/// TODO: Multiple files
-			QFile segmented_file;
+			uptr<Pipeline> pipeline;
 
-			/// The number of lines in the corpus
-			uint lines;
+			/// The thread which runs the current stage
+			std::thread job;
 
-			/// Statistics about characters and morphemes
-			QFile stats_file;
+			/// Actions disabled while a stage runs and their previous state
+			std::vector<std::pair<QAction*, bool>> job_actions;
 
 			/// Character occurrences
 			uptr<CharacterModel> character_model;
@@ -63,9 +66,23 @@ namespace Morpheus
 			/// Initalises connections between signals and slots
 			void setup_connections();
 
-			/// Preprocess the current line
-			/// (remove spaces, punctuation, etc.)
-			QString process_line(const QString&& _line);
+			/// Load the segmented corpus into its tab
+			void show_segmented_corpus();
+
+			///
+			/// \brief Run a stage of the pipeline on a worker thread.
+			/// The actions which start stages are disabled until it ends.
+			/// The results are committed on the GUI thread, and _done is then
+			/// called unless the stage failed or was cancelled.
+			/// \param _stage
+			/// \param _done
+			///
+			void run_job(const std::function<bool()>& _stage,
+						 const std::function<void()>& _done);
+
+			/// Called on the GUI thread when the stage started by run_job() returns
+			void finish_job(const bool _ok,
+							const std::function<void()>& _done);
 
 			/// Set the file names for the processed and segmented
 			/// versions of the corpus
@@ -103,10 +120,7 @@ namespace Morpheus
 
 			inline void clear_filenames()
 			{
-				input_file.setFileName("");
-				processed_file.setFileName("");
-				segmented_file.setFileName("");
-				stats_file.setFileName("");
+				pipeline->clear_input();
 			}
 
 			void load_corpus();
@@ -132,6 +146,9 @@ namespace Morpheus
 			/// Self-explanatory
 			void save_stats();
 
+			/// Export the dictionary as a model file for segmenting new text
+			void save_model();
+
 			/// Update the log
 			void update_log(const QString& _message);
 
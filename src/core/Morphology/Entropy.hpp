@@ -0,0 +1,203 @@
+#ifndef ENTROPY_HPP
+#define ENTROPY_HPP
+
+#include "Globals.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace Morpheus
+{
+	///
+	/// \brief Entropy of a distribution given as an array of counts.
+	///
+	/// For counts c_i with a total of N,
+	/// H = ln N - (1 / N) * sum(c_i * ln c_i),
+	/// so the only per-entry work is c * ln c. This is looked up
+	/// in a table for small counts and computed for the rest
+	/// (two at a time with SSE2 where it is available).
+	///
+	class Entropy
+	{
+		public:
+
+			/// Counts below this are looked up in the table
+			static constexpr uint table_size = 4096;
+
+			///
+			/// \brief Return n * ln n (0 for n = 0)
+			/// \param _n
+			/// \return
+			///
+			static inline real n_log_n(const uint _n)
+			{
+				if (_n < table_size)
+				{
+					return table()[_n];
+				}
+				return _n * std::log(static_cast<real>(_n));
+			}
+
+			///
+			/// \brief Return the sum of c * ln c over an array of counts
+			/// \param _counts
+			/// \param _size
+			/// \return
+			///
+			static inline real sum_n_log_n(const uint* _counts,
+										   const uint _size)
+			{
+				const std::vector<real>& tbl(table());
+				real sum(0.0);
+
+#ifdef __SSE2__
+				/// Large counts are collected and their logarithms
+				/// computed in pairs
+				real pending(0.0);
+				bool has_pending(false);
+
+				for (uint i = 0; i < _size; ++i)
+				{
+					if (_counts[i] < table_size)
+					{
+						sum += tbl[_counts[i]];
+					}
+					else if (!has_pending)
+					{
+						pending = _counts[i];
+						has_pending = true;
+					}
+					else
+					{
+						__m128d x(_mm_set_pd(static_cast<real>(_counts[i]), pending));
+						__m128d nln(_mm_mul_pd(x, log_pd(x)));
+						real out[2];
+						_mm_storeu_pd(out, nln);
+						sum += out[0] + out[1];
+						has_pending = false;
+					}
+				}
+
+				if (has_pending)
+				{
+					sum += pending * std::log(pending);
+				}
+#else
+				for (uint i = 0; i < _size; ++i)
+				{
+					sum += (_counts[i] < table_size ? tbl[_counts[i]] : n_log_n(_counts[i]));
+				}
+#endif
+				return sum;
+			}
+
+			///
+			/// \brief Return the entropy of the distribution given by the counts
+			/// \param _counts
+			/// \param _size
+			/// \param _total: the sum of all counts
+			/// \return
+			///
+			static inline real entropy(const uint* _counts,
+									   const uint _size,
+									   const uint _total)
+			{
+				if (_total == 0)
+				{
+					return 0.0;
+				}
+				return std::log(static_cast<real>(_total)) - sum_n_log_n(_counts, _size) / _total;
+			}
+
+			///
+			/// \brief Return -p * ln p for p = _count / _total
+			/// \param _count
+			/// \param _total
+			/// \return
+			///
+			static inline real partial(const uint _count,
+									   const uint _total)
+			{
+				if (_count == 0
+					|| _total == 0)
+				{
+					return 0.0;
+				}
+				return (_count * std::log(static_cast<real>(_total)) - n_log_n(_count)) / _total;
+			}
+
+		private:
+
+			///
+			/// \brief The table of n * ln n, built on first use
+			/// \return
+			///
+			static inline const std::vector<real>& table()
+			{
+				static const std::vector<real> tbl([]
+				{
+					std::vector<real> t(table_size, 0.0);
+					for (uint n = 2; n < table_size; ++n)
+					{
+						t[n] = n * std::log(static_cast<real>(n));
+					}
+					return t;
+				}());
+				return tbl;
+			}
+
+#ifdef __SSE2__
+			///
+			/// \brief Natural logarithm of two positive, finite doubles.
+			/// x = 2^e * m with m in [sqrt(1/2), sqrt(2)), and
+			/// ln m = 2 * atanh(s) with s = (m - 1) / (m + 1), which
+			/// converges quickly since |s| < 0.172.
+			/// \param _x
+			/// \return
+			///
+			static inline __m128d log_pd(const __m128d _x)
+			{
+				const __m128d one(_mm_set1_pd(1.0));
+
+				__m128i bits(_mm_castpd_si128(_x));
+
+				/// Unbiased exponent
+				__m128i exp(_mm_srli_epi64(bits, 52));
+				exp = _mm_shuffle_epi32(exp, _MM_SHUFFLE(3, 3, 2, 0));
+				__m128d e(_mm_sub_pd(_mm_cvtepi32_pd(exp), _mm_set1_pd(1023.0)));
+
+				/// Mantissa in [1, 2)
+				bits = _mm_and_si128(bits, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL));
+				bits = _mm_or_si128(bits, _mm_set1_epi64x(0x3FF0000000000000LL));
+				__m128d m(_mm_castsi128_pd(bits));
+
+				/// Move the mantissa to [sqrt(1/2), sqrt(2))
+				__m128d mask(_mm_cmpgt_pd(m, _mm_set1_pd(1.4142135623730951)));
+				m = _mm_or_pd(_mm_and_pd(mask, _mm_mul_pd(m, _mm_set1_pd(0.5))),
+							  _mm_andnot_pd(mask, m));
+				e = _mm_add_pd(e, _mm_and_pd(mask, one));
+
+				__m128d s(_mm_div_pd(_mm_sub_pd(m, one), _mm_add_pd(m, one)));
+				__m128d s2(_mm_mul_pd(s, s));
+
+				/// 1 + s^2/3 + s^4/5 + ... + s^16/17
+				__m128d poly(_mm_set1_pd(1.0 / 17.0));
+				poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 15.0));
+				poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 13.0));
+				poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 11.0));
+				poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 9.0));
+				poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 7.0));
+				poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 5.0));
+				poly = _mm_add_pd(_mm_mul_pd(poly, s2), _mm_set1_pd(1.0 / 3.0));
+				poly = _mm_add_pd(_mm_mul_pd(poly, s2), one);
+
+				__m128d log_m(_mm_mul_pd(_mm_mul_pd(_mm_set1_pd(2.0), s), poly));
+
+				return _mm_add_pd(_mm_mul_pd(e, _mm_set1_pd(0.6931471805599453)), log_m);
+			}
+#endif
+	};
+}
+
+#endif // ENTROPY_HPP
@@ -0,0 +1,212 @@
+#include "FrozenModel.hpp"
+
+namespace Morpheus
+{
+	constexpr uint FrozenModel::no_node;
+	constexpr quint32 FrozenModel::version;
+
+	const char FrozenModel::magic[8] = {'M', 'O', 'R', 'P', 'H', 'M', 'D', 'L'};
+
+	bool FrozenModel::save(const QString& _filename,
+						   const MorphemeDictionary& _dictionary,
+						   const QHash<QChar, real>& _char_code_length,
+						   const QList<QPair<QString, QString>>& _config,
+						   QString& _error)
+	{
+		/// Number the nodes breadth first, with the children of each node
+		/// sorted by their label and stored next to each other
+		std::vector<uint> nodes(1, MorphemeDictionary::root);
+		std::vector<quint32> child_begin;
+		std::vector<quint16> label(1, 0);
+		std::vector<uint> begin;
+		std::vector<uint> children;
+		_dictionary.get_children(begin, children);
+
+		for (uint n = 0; n < nodes.size(); ++n)
+		{
+			child_begin.push_back(nodes.size());
+			for (uint c = begin[nodes[n]]; c < begin[nodes[n] + 1]; ++c)
+			{
+				nodes.push_back(children[c]);
+				label.push_back(_dictionary.label(children[c]));
+			}
+		}
+		child_begin.push_back(nodes.size());
+
+		const real log_total(std::log(static_cast<real>(std::max(_dictionary.get_total(), 1u))));
+		std::vector<float> costs(nodes.size());
+		for (uint n = 0; n < nodes.size(); ++n)
+		{
+			const uint count(n == 0 ? 0 : _dictionary.count(nodes[n]));
+			costs[n] = (count == 0 ? std::numeric_limits<float>::infinity() : log_total - std::log(static_cast<real>(count)));
+		}
+
+		/// The alphabet
+		std::vector<quint16> chars;
+		real unknown_char_cost(0.0);
+		for (QHash<QChar, real>::const_iterator it = _char_code_length.constBegin(); it != _char_code_length.constEnd(); ++it)
+		{
+			chars.push_back(it.key().unicode());
+			unknown_char_cost = std::max(unknown_char_cost, it.value());
+		}
+		std::sort(chars.begin(), chars.end());
+
+		std::vector<float> char_costs;
+		for (const quint16 ch : chars)
+		{
+			char_costs.push_back(_char_code_length.value(QChar(ch)));
+		}
+
+		QByteArray config;
+		for (const QPair<QString, QString>& entry : _config)
+		{
+			config.append((entry.first + "=" + entry.second + "\n").toUtf8());
+		}
+
+		Header header;
+		std::copy(magic, magic + sizeof(magic), header.magic);
+		header.version = version;
+		header.byte_order = 0x01020304;
+		header.node_count = nodes.size();
+		header.char_count = chars.size();
+		header.morpheme_count = _dictionary.size();
+		header.total = _dictionary.get_total();
+		header.config_size = config.size();
+		header.unknown_char_cost = unknown_char_cost;
+		header.log_total = log_total;
+		header.reserved = 0;
+
+		QSaveFile model_file(_filename);
+		if (!model_file.open(QIODevice::WriteOnly))
+		{
+			_error = model_file.errorString();
+			return false;
+		}
+
+		const char padding[4] = {0, 0, 0, 0};
+		auto write = [&](const void* _data, const quint64 _bytes)
+		{
+			model_file.write(static_cast<const char*>(_data), _bytes);
+			model_file.write(padding, padded(_bytes) - _bytes);
+		};
+
+		write(&header, sizeof(header));
+		write(child_begin.data(), child_begin.size() * sizeof(quint32));
+		write(label.data(), label.size() * sizeof(quint16));
+		write(costs.data(), costs.size() * sizeof(float));
+		write(chars.data(), chars.size() * sizeof(quint16));
+		write(char_costs.data(), char_costs.size() * sizeof(float));
+		write(config.constData(), config.size());
+
+		if (!model_file.commit())
+		{
+			_error = model_file.errorString();
+			return false;
+		}
+		return true;
+	}
+
+	bool FrozenModel::load(const QString& _filename,
+						   QString& _error)
+	{
+		/// Closing the file also unmaps the previous model
+		_error.clear();
+		header = nullptr;
+		root_children.clear();
+		file.close();
+
+		file.setFileName(_filename);
+		if (!file.open(QIODevice::ReadOnly))
+		{
+			_error = file.errorString();
+			return false;
+		}
+
+		const quint64 size(file.size());
+		const uchar* data(size < sizeof(Header) ? nullptr : file.map(0, size));
+		if (data == nullptr)
+		{
+			_error = (size < sizeof(Header) ? "Not a model file" : file.errorString());
+			file.close();
+			return false;
+		}
+
+		const Header* h(reinterpret_cast<const Header*>(data));
+		if (!std::equal(magic, magic + sizeof(magic), h->magic))
+		{
+			_error = "Not a model file";
+		}
+		else if (h->version != version)
+		{
+			_error = "Unsupported model version " + QString::number(h->version);
+		}
+		else if (h->byte_order != 0x01020304)
+		{
+			_error = "The model was written on a machine with a different byte order";
+		}
+		else if (h->node_count == 0
+				 || size < sizeof(Header)
+				 + padded((static_cast<quint64>(h->node_count) + 1) * sizeof(quint32))
+				 + padded(static_cast<quint64>(h->node_count) * sizeof(quint16))
+				 + static_cast<quint64>(h->node_count) * sizeof(float)
+				 + padded(static_cast<quint64>(h->char_count) * sizeof(quint16))
+				 + static_cast<quint64>(h->char_count) * sizeof(float)
+				 + h->config_size)
+		{
+			_error = "The model file is truncated";
+		}
+
+		if (!_error.isEmpty())
+		{
+			file.close();
+			return false;
+		}
+
+		const uchar* pos(data + sizeof(Header));
+		child_begin = reinterpret_cast<const quint32*>(pos);
+		pos += padded((static_cast<quint64>(h->node_count) + 1) * sizeof(quint32));
+		label = reinterpret_cast<const quint16*>(pos);
+		pos += padded(static_cast<quint64>(h->node_count) * sizeof(quint16));
+		costs = reinterpret_cast<const float*>(pos);
+		pos += static_cast<quint64>(h->node_count) * sizeof(float);
+		chars = reinterpret_cast<const quint16*>(pos);
+		pos += padded(static_cast<quint64>(h->char_count) * sizeof(quint16));
+		char_costs = reinterpret_cast<const float*>(pos);
+		pos += static_cast<quint64>(h->char_count) * sizeof(float);
+		config = reinterpret_cast<const char*>(pos);
+
+		/// The trie is walked without bounds checks,
+		/// so make sure that every child is a valid node
+		for (uint n = 0; n < h->node_count; ++n)
+		{
+			if (child_begin[n] > child_begin[n + 1]
+				|| child_begin[n + 1] > h->node_count
+				|| child_begin[n] <= n)
+			{
+				_error = "The model file is corrupt";
+				file.close();
+				return false;
+			}
+		}
+
+		root_children.assign(std::numeric_limits<quint16>::max() + 1, no_node);
+		for (uint c = child_begin[0]; c < child_begin[1]; ++c)
+		{
+			root_children[label[c]] = c;
+		}
+
+		header = h;
+		return true;
+	}
+
+	QList<QPair<QString, QString>> FrozenModel::get_config() const
+	{
+		QList<QPair<QString, QString>> entries;
+		for (const QString& line : QString::fromUtf8(config, header->config_size).split('\n', skip_empty_parts))
+		{
+			const int eq(line.indexOf('='));
+			entries.append(qMakePair(line.left(eq), line.mid(eq + 1)));
+		}
+		return entries;
+	}
+}
@@ -0,0 +1,186 @@
+#ifndef FROZENMODEL_HPP
+#define FROZENMODEL_HPP
+
+#include "Globals.hpp"
+#include "MorphemeDictionary.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief A read-only morpheme model loaded from a memory-mapped file.
+	///
+	/// The file holds the morpheme trie with the cost of each morpheme,
+	/// the code lengths of the characters and the settings used for
+	/// training. Nothing is parsed or copied when the file is loaded:
+	/// the arrays are used in place, so loading takes about as long
+	/// as mapping the file, and no corpus or suffix array is needed.
+	/// The model can be used with ViterbiSegmenter.
+	///
+	/// Layout (host byte order, each section padded to 4 bytes):
+	///   Header
+	///   quint32 child_begin[node_count + 1]: the children of node n
+	///           are the nodes [child_begin[n], child_begin[n + 1])
+	///   quint16 label[node_count]: character on the edge into each node
+	///   float   cost[node_count]: -ln(c / N) (infinity if no morpheme ends there)
+	///   quint16 chars[char_count]: the alphabet in ascending order
+	///   float   char_cost[char_count]: code length of each character
+	///   char    config[config_size]: "key=value" lines (UTF-8)
+	///
+	/// Nodes are numbered breadth first (the root is node 0),
+	/// and the children of each node are sorted by their label.
+	///
+	class FrozenModel
+	{
+		public:
+
+			static constexpr uint no_node = std::numeric_limits<uint>::max();
+
+		private:
+
+			Q_DISABLE_COPY(FrozenModel)
+
+			/// Increased whenever the layout changes
+			static constexpr quint32 version = 1;
+
+			struct Header
+			{
+					char magic[8];
+					quint32 version;
+
+					/// 0x01020304 as written by the exporting machine
+					quint32 byte_order;
+
+					quint32 node_count;
+					quint32 char_count;
+					quint32 morpheme_count;
+					quint32 total;
+					quint32 config_size;
+
+					/// Code length of characters outside the alphabet
+					float unknown_char_cost;
+
+					/// ln N
+					float log_total;
+
+					quint32 reserved;
+			};
+
+			static const char magic[8];
+
+			/// Padding to the next multiple of 4 bytes
+			static inline quint64 padded(const quint64 _bytes)
+			{
+				return (_bytes + 3) & ~static_cast<quint64>(3);
+			}
+
+			QFile file;
+
+			const Header* header;
+			const quint32* child_begin;
+			const quint16* label;
+			const float* costs;
+			const quint16* chars;
+			const float* char_costs;
+			const char* config;
+
+			/// Direct index of the children of the root
+			std::vector<uint> root_children;
+
+		public:
+
+			FrozenModel()
+				:
+				  header(nullptr)
+			{}
+
+			///
+			/// \brief Write a model file
+			/// \param _filename
+			/// \param _dictionary
+			/// \param _char_code_length
+			/// \param _config: the settings used for training
+			/// \param _error: receives the reason for a failure
+			/// \return Whether the file was written
+			///
+			static bool save(const QString& _filename,
+							 const MorphemeDictionary& _dictionary,
+							 const QHash<QChar, real>& _char_code_length,
+							 const QList<QPair<QString, QString>>& _config,
+							 QString& _error);
+
+			///
+			/// \brief Map a model file into memory and check its layout
+			/// \param _filename
+			/// \param _error: receives the reason for a failure
+			/// \return Whether the model was loaded
+			///
+			bool load(const QString& _filename,
+					  QString& _error);
+
+			/// Whether a model is loaded
+			inline bool is_loaded() const
+			{
+				return header != nullptr;
+			}
+
+			/// Number of distinct morphemes
+			inline uint size() const
+			{
+				return header->morpheme_count;
+			}
+
+			/// Total morpheme count in the training corpus
+			inline uint get_total() const
+			{
+				return header->total;
+			}
+
+			///
+			/// \brief The settings used for training
+			/// \return (key, value) pairs in the order in which they were saved
+			///
+			QList<QPair<QString, QString>> get_config() const;
+
+			/// \name Model interface for ViterbiSegmenter
+			/// \{
+
+			inline uint root() const
+			{
+				return 0;
+			}
+
+			inline uint step(const uint _node,
+							 const QChar _ch) const
+			{
+				if (_node == 0)
+				{
+					return root_children[_ch.unicode()];
+				}
+
+				const quint16* begin(label + child_begin[_node]);
+				const quint16* end(label + child_begin[_node + 1]);
+				const quint16* it(std::lower_bound(begin, end, _ch.unicode()));
+				return ((it == end || *it != _ch.unicode()) ? no_node : static_cast<uint>(it - label));
+			}
+
+			inline real cost(const uint _node) const
+			{
+				return costs[_node];
+			}
+
+			inline real unknown_cost(const QStringView _ch) const
+			{
+				real length(header->log_total);
+				for (const QChar ch : _ch)
+				{
+					const quint16* it(std::lower_bound(chars, chars + header->char_count, ch.unicode()));
+					length += ((it == chars + header->char_count || *it != ch.unicode()) ? header->unknown_char_cost : char_costs[it - chars]);
+				}
+				return length;
+			}
+
+			/// \}
+	};
+}
+
+#endif // FROZENMODEL_HPP
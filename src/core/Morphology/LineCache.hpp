@@ -0,0 +1,166 @@
+#ifndef LINECACHE_HPP
+#define LINECACHE_HPP
+
+#include "Globals.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief A bounded cache of line segmentations keyed by
+	/// a 64-bit fingerprint of the line. The line itself is kept
+	/// to rule out collisions. When the cache is full, the oldest
+	/// entry is evicted.
+	///
+	class LineCache
+	{
+		public:
+
+			struct Entry
+			{
+					QString line;
+
+					/// The morphemes in the order in which they appear
+					/// (a morpheme may contain spaces)
+					QStringList morphemes;
+
+					/// The morphemes joined by spaces
+					QString segmentation;
+			};
+
+		private:
+
+			/// Cached segmentations
+			hashmap<quint64, Entry> entries;
+
+			/// Fingerprints in order of insertion
+			std::deque<quint64> order;
+
+			/// Maximum number of entries (0 disables the cache)
+			uint capacity;
+
+			/// Statistics
+			uint hits;
+			uint lookups;
+
+		public:
+
+			LineCache(const uint _capacity = 0)
+				:
+				  capacity(_capacity),
+				  hits(0),
+				  lookups(0)
+			{}
+
+			///
+			/// \brief FNV-1a hash of the UTF-16 code units of a line
+			/// \param _line
+			/// \return
+			///
+			static inline quint64 fingerprint(const QString& _line)
+			{
+				quint64 hash(14695981039346656037ULL);
+				for (const QChar ch : _line)
+				{
+					hash ^= ch.unicode();
+					hash *= 1099511628211ULL;
+				}
+				return hash;
+			}
+
+			///
+			/// \brief Look up the segmentation of a line
+			/// \param _line
+			/// \param _fingerprint
+			/// \return The cached entry or nullptr
+			///
+			inline const Entry* find(const QString& _line,
+									   const quint64 _fingerprint)
+			{
+				if (capacity == 0)
+				{
+					return nullptr;
+				}
+
+				++lookups;
+				hashmap<quint64, Entry>::const_iterator it(entries.find(_fingerprint));
+				if (it != entries.end()
+					&& it->second.line == _line)
+				{
+					++hits;
+					return &it->second;
+				}
+				return nullptr;
+			}
+
+			///
+			/// \brief Store the segmentation of a line
+			/// \param _line
+			/// \param _fingerprint
+			/// \param _morphemes
+			/// \param _segmentation
+			///
+			inline void insert(const QString& _line,
+							   const quint64 _fingerprint,
+							   const QStringList& _morphemes,
+							   const QString& _segmentation)
+			{
+				if (capacity == 0
+					|| entries.count(_fingerprint) > 0)
+				{
+					return;
+				}
+
+				while (entries.size() >= capacity)
+				{
+					entries.erase(order.front());
+					order.pop_front();
+				}
+
+				entries[_fingerprint] = Entry{_line, _morphemes, _segmentation};
+				order.push_back(_fingerprint);
+			}
+
+			///
+			/// \brief Remove all entries but keep the statistics
+			///
+			inline void clear()
+			{
+				entries.clear();
+				order.clear();
+			}
+
+			///
+			/// \brief Remove all entries and reset the statistics
+			/// \param _capacity
+			///
+			inline void reset(const uint _capacity)
+			{
+				clear();
+				capacity = _capacity;
+				hits = 0;
+				lookups = 0;
+			}
+
+			///
+			/// \brief Add the statistics of another cache to this one
+			/// \param _other
+			///
+			inline void merge_statistics(const LineCache& _other)
+			{
+				hits += _other.hits;
+				lookups += _other.lookups;
+			}
+
+			inline uint get_hits() const
+			{
+				return hits;
+			}
+
+			inline uint get_lookups() const
+			{
+				return lookups;
+			}
+	};
+}
+
+#endif // LINECACHE_HPP
@@ -0,0 +1,340 @@
+#include "MorphemeDictionary.hpp"
+
+namespace Morpheus
+{
+	constexpr uint MorphemeDictionary::no_node;
+	constexpr uint MorphemeDictionary::root;
+
+	uint MorphemeDictionary::add_child(const uint _node,
+									   const ushort _ch)
+	{
+		uint id(0);
+		if (!free_nodes.empty())
+		{
+			id = free_nodes.back();
+			free_nodes.pop_back();
+			labels[id] = _ch;
+			parents[id] = _node;
+			counts[id] = 0;
+			child_counts[id] = 0;
+		}
+		else
+		{
+			id = labels.size();
+			labels.push_back(_ch);
+			parents.push_back(_node);
+			counts.push_back(0);
+			child_counts.push_back(0);
+		}
+
+		if (child_counts[_node] < 0xFFFF)
+		{
+			++child_counts[_node];
+		}
+
+		/// Keep the child index at most half full
+		if (2 * (labels.size() - free_nodes.size()) > child_index.size())
+		{
+			grow();
+		}
+		else
+		{
+			index(id);
+		}
+		return id;
+	}
+
+	void MorphemeDictionary::index(const uint _node)
+	{
+		const uint mask(child_index.size() - 1);
+		uint s(home_slot(parents[_node], labels[_node]));
+		while (child_index[s] != no_node)
+		{
+			s = (s + 1) & mask;
+		}
+		child_index[s] = _node;
+	}
+
+	void MorphemeDictionary::grow()
+	{
+		child_index.assign(2 * child_index.size(), no_node);
+		--shift;
+		for (uint node = 1; node < labels.size(); ++node)
+		{
+			if (parents[node] != no_node)
+			{
+				index(node);
+			}
+		}
+	}
+
+	void MorphemeDictionary::release(uint _node)
+	{
+		const uint mask(child_index.size() - 1);
+		while (_node != root
+			   && counts[_node] == 0
+			   && child_counts[_node] == 0)
+		{
+			/// Remove the node from the child index, moving back
+			/// the entries after it which would no longer be found
+			uint hole(home_slot(parents[_node], labels[_node]));
+			while (child_index[hole] != _node)
+			{
+				hole = (hole + 1) & mask;
+			}
+
+			for (uint s = (hole + 1) & mask; child_index[s] != no_node; s = (s + 1) & mask)
+			{
+				const uint home(home_slot(parents[child_index[s]], labels[child_index[s]]));
+				if (((s - home) & mask) >= ((s - hole) & mask))
+				{
+					child_index[hole] = child_index[s];
+					hole = s;
+				}
+			}
+			child_index[hole] = no_node;
+
+			const uint up(parents[_node]);
+			if (child_counts[up] < 0xFFFF)
+			{
+				--child_counts[up];
+			}
+
+			parents[_node] = no_node;
+			free_nodes.push_back(_node);
+			_node = up;
+		}
+	}
+
+	uint MorphemeDictionary::find(const QStringView _str) const
+	{
+		const int size(_str.size());
+		uint node(root);
+		for (int i = 0; i < size && node != no_node; ++i)
+		{
+			node = child(node, _str.at(i).unicode());
+		}
+		return node;
+	}
+
+	uint MorphemeDictionary::insert(const QStringView _str)
+	{
+		const int size(_str.size());
+		uint node(root);
+		for (int i = 0; i < size; ++i)
+		{
+			const ushort ch(_str.at(i).unicode());
+			uint next(child(node, ch));
+			node = (next == no_node ? add_child(node, ch) : next);
+		}
+		return node;
+	}
+
+	uint MorphemeDictionary::increment(const QStringView _morpheme,
+									   const uint _by)
+	{
+		if (_morpheme.size() == 0
+			|| _by == 0)
+		{
+			return value(_morpheme);
+		}
+
+		const uint node(insert(_morpheme));
+		set_count(node, counts[node] + _by);
+		return counts[node];
+	}
+
+	uint MorphemeDictionary::decrement(const QStringView _morpheme,
+									   const uint _by)
+	{
+		const uint node(find(_morpheme));
+		if (node == no_node
+			|| counts[node] == 0)
+		{
+			return 0;
+		}
+
+		set_count(node, counts[node] - std::min(_by, counts[node]));
+		if (counts[node] == 0)
+		{
+			release(node);
+			return 0;
+		}
+		return counts[node];
+	}
+
+	void MorphemeDictionary::set_count(const uint _node,
+									   const uint _count)
+	{
+		const uint old(counts[_node]);
+		if (old == 0
+			&& _count > 0)
+		{
+			++distinct;
+		}
+		else if (old > 0
+				 && _count == 0)
+		{
+			--distinct;
+		}
+		total = total - old + _count;
+		counts[_node] = _count;
+	}
+
+	void MorphemeDictionary::merge(const MorphemeDictionary& _other)
+	{
+		_other.for_each([&](const QString& _morpheme, const uint _count)
+		{
+			increment(_morpheme, _count);
+		});
+	}
+
+	void MorphemeDictionary::clear()
+	{
+		labels.assign(1, 0);
+		parents.assign(1, no_node);
+		counts.assign(1, 0);
+		child_counts.assign(1, 0);
+		child_index.assign(16, no_node);
+		shift = 64 - 4;
+		free_nodes.clear();
+		distinct = 0;
+		total = 0;
+	}
+
+	void MorphemeDictionary::append(uint _node,
+									QString& _str) const
+	{
+		/// The path is collected from the node up to the root
+		const int begin(_str.size());
+		while (_node != root
+			   && _node != no_node)
+		{
+			_str.append(QChar(labels[_node]));
+			_node = parents[_node];
+		}
+		std::reverse(_str.begin() + begin, _str.end());
+	}
+
+	void MorphemeDictionary::get_children(std::vector<uint>& _begin,
+										  std::vector<uint>& _children) const
+	{
+		/// Counting sort of the nodes by their parent
+		_begin.assign(labels.size() + 1, 0);
+		for (uint node = 1; node < labels.size(); ++node)
+		{
+			if (parents[node] != no_node)
+			{
+				++_begin[parents[node] + 1];
+			}
+		}
+
+		for (uint node = 0; node < labels.size(); ++node)
+		{
+			_begin[node + 1] += _begin[node];
+		}
+
+		_children.assign(_begin.back(), no_node);
+		std::vector<uint> next(_begin.begin(), _begin.end() - 1);
+		for (uint node = 1; node < labels.size(); ++node)
+		{
+			if (parents[node] != no_node)
+			{
+				_children[next[parents[node]]++] = node;
+			}
+		}
+
+		for (uint node = 0; node < labels.size(); ++node)
+		{
+			std::sort(_children.begin() + _begin[node], _children.begin() + _begin[node + 1], [&](const uint _lhs, const uint _rhs)
+			{
+				return labels[_lhs] < labels[_rhs];
+			});
+		}
+	}
+
+	std::vector<uint> MorphemeDictionary::by_frequency() const
+	{
+		std::vector<uint> nodes;
+		nodes.reserve(distinct);
+		for (uint node = 1; node < counts.size(); ++node)
+		{
+			if (counts[node] > 0)
+			{
+				nodes.push_back(node);
+			}
+		}
+
+		std::stable_sort(nodes.begin(), nodes.end(), [&](const uint _lhs, const uint _rhs)
+		{
+			return counts[_lhs] > counts[_rhs];
+		});
+		return nodes;
+	}
+
+	QStringList MorphemeDictionary::with_prefix(const QStringView _prefix,
+												const uint _max) const
+	{
+		QStringList morphemes;
+		const uint prefix(find(_prefix));
+		if (prefix == no_node)
+		{
+			return morphemes;
+		}
+
+		std::vector<uint> begin;
+		std::vector<uint> children;
+		get_children(begin, children);
+
+		/// Depth first through the subtree of the prefix, with the
+		/// children in the order of their labels, so the morphemes
+		/// come out sorted
+		std::vector<uint> stack(1, prefix);
+		while (!stack.empty()
+			   && (_max == 0
+				   || static_cast<uint>(morphemes.size()) < _max))
+		{
+			const uint node(stack.back());
+			stack.pop_back();
+
+			if (counts[node] > 0)
+			{
+				morphemes.append(morpheme(node));
+			}
+
+			for (uint c = begin[node + 1]; c > begin[node]; --c)
+			{
+				stack.push_back(children[c - 1]);
+			}
+		}
+		return morphemes;
+	}
+
+	QStringList MorphemeDictionary::with_suffix(const QStringView _suffix,
+												const uint _max) const
+	{
+		QStringList morphemes;
+		QString str;
+		for (uint node = 1; node < counts.size(); ++node)
+		{
+			if (_max > 0
+				&& static_cast<uint>(morphemes.size()) >= _max)
+			{
+				break;
+			}
+
+			if (counts[node] == 0)
+			{
+				continue;
+			}
+
+			str.clear();
+			append(node, str);
+			if (QStringView(str).endsWith(_suffix))
+			{
+				morphemes.append(str);
+			}
+		}
+		return morphemes;
+	}
+}
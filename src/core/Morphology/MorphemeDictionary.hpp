@@ -0,0 +1,334 @@
+#ifndef MORPHEMEDICTIONARY_HPP
+#define MORPHEMEDICTIONARY_HPP
+
+#include "Globals.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief A compact morpheme dictionary backed by a trie.
+	///
+	/// Nodes are stored in parallel arrays (label, parent, count and
+	/// number of children), so shared prefixes are stored once and each
+	/// node costs 12 bytes. The children are not linked from their parent:
+	/// a single hash table with linear probing maps (parent, label) to
+	/// the child, so walking the trie takes one lookup per character
+	/// whatever the number of siblings. A slot holds only the id of the
+	/// child, whose label and parent are compared when probing.
+	///
+	/// A node whose count is nonzero marks the end of a morpheme.
+	/// When the count of a morpheme drops to 0 (see decrement()), its node
+	/// and any ancestors left without a morpheme or children are released
+	/// and their ids are reused. Other node ids are stable until clear().
+	///
+	class MorphemeDictionary
+	{
+		public:
+
+			/// Marks a missing node
+			static constexpr uint no_node = std::numeric_limits<uint>::max();
+
+			/// The root of the morpheme trie (the empty string)
+			static constexpr uint root = 0;
+
+		private:
+
+			/// Character on the edge into each node
+			std::vector<ushort> labels;
+
+			/// Parent of each node (no_node for the root and released nodes)
+			std::vector<uint> parents;
+
+			/// Number of occurrences of the string ending at each node
+			std::vector<uint> counts;
+
+			/// Number of children of each node (saturates at 0xFFFF,
+			/// in which case the node is never released)
+			std::vector<ushort> child_counts;
+
+			/// Child index: node ids (no_node in empty slots).
+			/// The table has 2^(64 - shift) slots and is at most half full.
+			std::vector<uint> child_index;
+			uint shift;
+
+			/// Released nodes which can be reused
+			std::vector<uint> free_nodes;
+
+			/// Number of distinct morphemes
+			uint distinct;
+
+			/// Sum of all counts
+			uint total;
+
+			/// The home slot of the child of _node along _ch
+			inline uint home_slot(const uint _node,
+								  const ushort _ch) const
+			{
+				return static_cast<uint>((((static_cast<quint64>(_node) << 16) | _ch) * 0x9E3779B97F4A7C15ULL) >> shift);
+			}
+
+			/// The child of _node along _ch
+			inline uint child(const uint _node,
+							  const ushort _ch) const
+			{
+				const uint mask(child_index.size() - 1);
+				for (uint s = home_slot(_node, _ch); ; s = (s + 1) & mask)
+				{
+					const uint node(child_index[s]);
+					if (node == no_node
+						|| (labels[node] == _ch
+							&& parents[node] == _node))
+					{
+						return node;
+					}
+				}
+			}
+
+			/// Add a child to _node along _ch
+			uint add_child(const uint _node,
+						   const ushort _ch);
+
+			/// Put a node in the child index
+			void index(const uint _node);
+
+			/// Double the size of the child index
+			void grow();
+
+			///
+			/// \brief Release a node without a morpheme or children,
+			/// then its ancestors which are left in the same state
+			/// \param _node
+			///
+			void release(uint _node);
+
+		public:
+
+			MorphemeDictionary()
+			{
+				clear();
+			}
+
+			///
+			/// \brief Check whether a morpheme is in the dictionary
+			/// \param _morpheme
+			/// \return
+			///
+			inline bool contains(const QStringView _morpheme) const
+			{
+				return value(_morpheme) > 0;
+			}
+
+			///
+			/// \brief Return the count of a morpheme (0 if it is not in the dictionary)
+			/// \param _morpheme
+			/// \return
+			///
+			inline uint value(const QStringView _morpheme) const
+			{
+				uint node(find(_morpheme));
+				return (node == no_node ? 0 : counts[node]);
+			}
+
+			///
+			/// \brief Return the node for a string
+			/// \param _str
+			/// \return no_node if no morpheme starts with _str
+			///
+			uint find(const QStringView _str) const;
+
+			///
+			/// \brief Return the node for a string, creating it
+			/// (with a count of 0) if necessary. The node is only
+			/// released if the count of a morpheme ending at it
+			/// is decremented to 0.
+			/// \param _str
+			/// \return
+			///
+			uint insert(const QStringView _str);
+
+			///
+			/// \brief Add to the count of a morpheme, inserting it if necessary
+			/// \param _morpheme
+			/// \param _by
+			/// \return The new count
+			///
+			uint increment(const QStringView _morpheme,
+						   const uint _by = 1);
+
+			///
+			/// \brief Subtract from the count of a morpheme.
+			/// The morpheme is removed when its count reaches 0.
+			/// \param _morpheme
+			/// \param _by
+			/// \return The new count
+			///
+			uint decrement(const QStringView _morpheme,
+						   const uint _by = 1);
+
+			///
+			/// \brief Remove a morpheme
+			/// \param _morpheme
+			///
+			inline void remove(const QStringView _morpheme)
+			{
+				decrement(_morpheme, value(_morpheme));
+			}
+
+			///
+			/// \brief Set the count of the morpheme ending at a node.
+			/// Unlike decrement(), the node is kept when the count
+			/// drops to 0, so its id stays valid.
+			/// \param _node: a node returned by insert()
+			/// \param _count
+			///
+			void set_count(const uint _node,
+						   const uint _count);
+
+			///
+			/// \brief Add all counts from another dictionary
+			/// \param _other
+			///
+			void merge(const MorphemeDictionary& _other);
+
+			void clear();
+
+			inline void swap(MorphemeDictionary& _other)
+			{
+				std::swap(labels, _other.labels);
+				std::swap(parents, _other.parents);
+				std::swap(counts, _other.counts);
+				std::swap(child_counts, _other.child_counts);
+				std::swap(child_index, _other.child_index);
+				std::swap(shift, _other.shift);
+				std::swap(free_nodes, _other.free_nodes);
+				std::swap(distinct, _other.distinct);
+				std::swap(total, _other.total);
+			}
+
+			/// Number of distinct morphemes
+			inline uint size() const
+			{
+				return distinct;
+			}
+
+			/// Sum of the counts of all morphemes
+			inline uint get_total() const
+			{
+				return total;
+			}
+
+			/// One more than the largest node id
+			inline uint get_node_count() const
+			{
+				return labels.size();
+			}
+
+			/// Bytes allocated for the trie and the child index
+			inline ullong get_memory() const
+			{
+				return labels.capacity() * sizeof(ushort)
+						+ parents.capacity() * sizeof(uint)
+						+ counts.capacity() * sizeof(uint)
+						+ child_counts.capacity() * sizeof(ushort)
+						+ child_index.capacity() * sizeof(uint)
+						+ free_nodes.capacity() * sizeof(uint);
+			}
+
+			///
+			/// \brief Append the string ending at a node
+			/// \param _node
+			/// \param _str
+			///
+			void append(uint _node,
+						QString& _str) const;
+
+			/// The morpheme ending at a node
+			inline QString morpheme(const uint _node) const
+			{
+				QString str;
+				append(_node, str);
+				return str;
+			}
+
+			/// The count of the morpheme ending at a node
+			inline uint count(const uint _node) const
+			{
+				return counts[_node];
+			}
+
+			/// The character on the edge into a node
+			inline ushort label(const uint _node) const
+			{
+				return labels[_node];
+			}
+
+			///
+			/// \brief Walk the morpheme trie by one character
+			/// \param _node: root or a node returned by step()
+			/// \param _ch
+			/// \return The node for the extended string (no_node if no morpheme starts with it)
+			///
+			inline uint step(const uint _node,
+							 const QChar _ch) const
+			{
+				return child(_node, _ch.unicode());
+			}
+
+			///
+			/// \brief Return the children of all nodes, sorted by their label.
+			/// The children of node n are _children[_begin[n]] to _children[_begin[n + 1] - 1].
+			/// \param _begin: get_node_count() + 1 offsets
+			/// \param _children
+			///
+			void get_children(std::vector<uint>& _begin,
+							  std::vector<uint>& _children) const;
+
+			///
+			/// \brief Return the nodes of all morphemes,
+			/// from the most to the least frequent
+			/// \return
+			///
+			std::vector<uint> by_frequency() const;
+
+			///
+			/// \brief Call _f(morpheme, count) for each morpheme
+			/// \param _f
+			///
+			template <typename F>
+			void for_each(F&& _f) const
+			{
+				QString str;
+				for (uint node = 1; node < counts.size(); ++node)
+				{
+					if (counts[node] > 0)
+					{
+						str.clear();
+						append(node, str);
+						_f(str, counts[node]);
+					}
+				}
+			}
+
+			///
+			/// \brief Return the morphemes which start with _prefix,
+			/// in the order of their UTF-16 code units
+			/// \param _prefix
+			/// \param _max: maximum number of results (0 for all)
+			/// \return
+			///
+			QStringList with_prefix(const QStringView _prefix,
+									const uint _max = 0) const;
+
+			///
+			/// \brief Return the morphemes which end with _suffix.
+			/// No reversed trie is kept, so the morphemes are scanned.
+			/// \param _suffix
+			/// \param _max: maximum number of results (0 for all)
+			/// \return
+			///
+			QStringList with_suffix(const QStringView _suffix,
+									const uint _max = 0) const;
+	};
+}
+
+#endif // MORPHEMEDICTIONARY_HPP
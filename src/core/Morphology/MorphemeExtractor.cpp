@@ -1,37 +1,52 @@
 #include "MorphemeExtractor.hpp"
+#include <mutex>
+#include <condition_variable>
 
 namespace Morpheus
 {
+	constexpr uint MorphemeExtractor::parallel_block_size;
 
-	void MorphemeExtractor::extract_characters(const QString& _processed_file)
+	void MorphemeExtractor::begin_corpus()
 	{
-		total_char_count = 0;
+		reset();
 		char_transition_count = 0;
-		total_morpheme_count = 0;
-		alphabet.clear();
 		character_transitions.clear();
+		transition_pmi.clear();
 		char_code_length.clear();
-		QFile corpus(_processed_file);
-		QTextStream qts(&corpus);
-		QString line;
-		if (corpus.open(QFile::ReadOnly))
+		corpus_bytes.clear();
+	}
+
+	void MorphemeExtractor::add_line(const QString& _line)
+	{
+		uint index = 0;
+		for (const QChar& ch : _line)
 		{
-			while(qts.readLineInto(&line))
+			if (index > 0)
 			{
-				uint index = 0;
-				for (const QChar& ch : line)
-				{
-					//		    if (index > 0)
-					//		    {
-					//			++character_transitions[line.at(index - 1)][line.at(index)];
-					//			++char_transition_count;
-					//		    }
-					++alphabet[ch];
-					++total_char_count;
-					++index;
-				}
+				++character_transitions[transition(_line.at(index - 1), ch)];
+				++char_transition_count;
 			}
+			++alphabet[ch];
+			++total_char_count;
+			++index;
+		}
+
+		/// The suffix array is built over the lines as they are
+		/// written to the processed file
+		const QByteArray bytes(_line.toUtf8());
+		corpus_bytes.insert(corpus_bytes.end(), bytes.constData(), bytes.constData() + bytes.size());
+		corpus_bytes.push_back('\n');
+	}
+
+	bool MorphemeExtractor::end_corpus(ProgressSink& _progress,
+									   const CancellationToken& _cancel)
+	{
+		sa = std::make_shared<SuffixArray>();
+		if (!sa->set_input(std::move(corpus_bytes), _progress, _cancel))
+		{
+			return false;
 		}
+		corpus_bytes = std::vector<uchar>();
 
 		avg_char_prob = 0.0;
 		real count_tmp(static_cast<real>(total_char_count));
@@ -60,94 +75,124 @@ namespace Morpheus
 		}
 		alphabet_norm_ent = alphabet_ent / static_cast<real>(std::log(total_char_count));
 
+		/// PMI of each transition, log(p(ab) / (p(a) * p(b)))
+		for (const std::pair<uint, uint>& tr : character_transitions)
+		{
+			real p_ab(tr.second / static_cast<real>(char_transition_count));
+			real p_a(alphabet.value(QChar(static_cast<ushort>(tr.first >> 16))) / count_tmp);
+			real p_b(alphabet.value(QChar(static_cast<ushort>(tr.first & 0xFFFF))) / count_tmp);
+			transition_pmi[tr.first] = std::log(p_ab / (p_a * p_b));
+		}
+
 		emit characters_extracted();
+		return true;
+	}
+
+	bool MorphemeExtractor::init(const QString& _processed_file,
+								 ProgressSink& _progress,
+								 const CancellationToken& _cancel)
+	{
+		begin_corpus();
+
+		LineReader corpus;
+		QString error;
+		if (corpus.open(_processed_file, error))
+		{
+			QString line;
+			while (corpus.read_line(line))
+			{
+				if (_cancel.is_cancelled())
+				{
+					return false;
+				}
+				add_line(line);
+			}
+		}
+
+		return end_corpus(_progress, _cancel);
 	}
 
-	real MorphemeExtractor::get_predecessor_entropy(const QString& _string, const QString& _ch)
+	real MorphemeExtractor::get_predecessor_entropy(const QStringView _string,
+													const SuffixArray::Cursor& _cursor,
+													const QChar _ch)
 	{
-		if ((_ch + _string).size() == 0
-			|| get_distinct_predecessor_count(_string) == 0)
+		if ((_ch.isNull() && _string.size() == 0)
+			|| get_distinct_predecessor_count(_string, _cursor) == 0)
 		{
 			return alphabet_ent;
 		}
-		else if (get_distinct_predecessor_count(_string) == 1)
+		else if (get_distinct_predecessor_count(_string, _cursor) == 1)
 		{
 			return 0.0;
 		}
-		else if (!p_ent_cache.contains(_ch + _string))
+
+		const SuffixArray::Cursor::Key key(_cursor.key(_ch));
+		SuffixArray::interval_map<real>::const_iterator it(p_ent_cache.find(key));
+		if (it != p_ent_cache.end())
 		{
-			QHash<QChar, uint> predecessors_tmp(sa->get_predecessors(_string));
+			return it->second;
+		}
 
-			if (_ch.size() == 0)
-			{
-				real prob(0.0);
-				real ent(0.0);
-				uint total(0.0);
-				for (const QChar& ch : predecessors_tmp.keys())
-				{
-					total += predecessors_tmp[ch];
-				}
-				for (const QChar& ch : predecessors_tmp.keys())
-				{
-					prob = predecessors_tmp[ch] / static_cast<real>(total);
-					ent -= prob * std::log(prob);
-				}
-				p_ent_cache[_ch + _string] = ent;
-			}
-			else
-			{
-				real prob(predecessors_tmp[_ch.at(0)] / static_cast<real>(get_total_predecessor_count(_string)));
-				p_ent_cache[_ch + _string] = -prob * std::log(prob);
-			}
+		sa->count_predecessors(_cursor, neighbour_counts);
+		real ent(0.0);
+
+		if (_ch.isNull())
+		{
+			ent = Entropy::entropy(neighbour_counts.values.data(),
+								   neighbour_counts.values.size(),
+								   neighbour_counts.total);
+		}
+		else
+		{
+			ent = Entropy::partial(neighbour_counts.get(sa->get_symbol_id(_ch)),
+								   neighbour_counts.total);
 		}
-		return p_ent_cache[_ch + _string];
+		return p_ent_cache[key] = ent;
 	}
 
-	real MorphemeExtractor::get_successor_entropy(const QString& _string, const QString& _ch)
+	real MorphemeExtractor::get_successor_entropy(const QStringView _string,
+												  const SuffixArray::Cursor& _cursor,
+												  const QChar _ch)
 	{
-		if ((_string + _ch).size() == 0
-			|| get_distinct_successor_count(_string) == 0)
+		if ((_ch.isNull() && _string.size() == 0)
+			|| get_distinct_successor_count(_string, _cursor) == 0)
 		{
 			return alphabet_ent;
 		}
-		else if (get_distinct_successor_count(_string) == 1)
+		else if (get_distinct_successor_count(_string, _cursor) == 1)
 		{
 			return 0.0;
 		}
-		else if (!s_ent_cache.contains(_string + _ch))
+
+		const SuffixArray::Cursor::Key key(_cursor.key(_ch));
+		SuffixArray::interval_map<real>::const_iterator it(s_ent_cache.find(key));
+		if (it != s_ent_cache.end())
 		{
-			QHash<QChar, uint> successors_tmp(sa->get_successors(_string));
+			return it->second;
+		}
 
-			if (_ch.size() == 0)
-			{
-				real prob(0.0);
-				real ent(0.0);
-				uint total(0.0);
-				for (const QChar& ch : successors_tmp.keys())
-				{
-					total += successors_tmp[ch];
-				}
-				for (const QChar& ch : successors_tmp.keys())
-				{
-					prob = successors_tmp[ch] / static_cast<real>(total);
-					ent -= prob * std::log(prob);
-				}
-				s_ent_cache[_string + _ch] = ent;
-			}
-			else
-			{
-				real prob(successors_tmp[_ch.at(0)] / static_cast<real>(get_total_successor_count(_string)));
-				s_ent_cache[_string + _ch] = -prob * std::log(prob);
-			}
+		sa->count_successors(_cursor, neighbour_counts);
+		real ent(0.0);
+
+		if (_ch.isNull())
+		{
+			ent = Entropy::entropy(neighbour_counts.values.data(),
+								   neighbour_counts.values.size(),
+								   neighbour_counts.total);
+		}
+		else
+		{
+			ent = Entropy::partial(neighbour_counts.get(sa->get_symbol_id(_ch)),
+								   neighbour_counts.total);
 		}
-		return s_ent_cache[_string + _ch];
+		return s_ent_cache[key] = ent;
 	}
 
-	QString MorphemeExtractor::extract_morphemes_ps(const QString&& _line,
-													const bool _reseg)
+	template <typename Method, bool Trace>
+	QStringList MorphemeExtractor::extract_morphemes_ps(const QString&& _line)
 	{
 
-		if (Config::console_output)
+		if (Trace)
 		{
 			std::cout << "line: " << _line.toUtf8().constData() << std::endl;
 		}
@@ -156,50 +201,58 @@ namespace Morpheus
 		/// in the order in which they appear in the current line
 		QStringList tmp_dictionary;
 
-		/// A hapax which holds one or more morphemes
-		QString candidate;
+		/// All strings below are views into this line. The candidate,
+		/// the preceding morpheme and the left and right candidates are
+		/// always contiguous, so they are tracked as offsets and no
+		/// strings are built while looking for boundaries.
+		const QStringView line(_line);
 
-		/// The combined length of all morphemes in the line
-		uint line_size(_line.size());
+		/// Encode the line once. All suffix array queries below
+		/// are made with spans of this buffer.
+		SuffixArray::encode(line, line_bytes, line_offsets);
 
-		/// A list of individual morphemes in case of resegmentation
-		QStringList line_seg;
+		/// The length of the line
+		uint line_size(line.size());
 
-		/// The next morpheme in the list
-		uint next_morph(0);
+		/// Index along the current line (the end of the candidate)
+		uint line_index(0);
 
-		if (_reseg)
-		{
-			line_size -= _line.count(" ");
-			line_seg = _line.split(" ");
-		}
+		/// The start of the candidate
+		uint cand_begin(0);
 
-		/// The morpheme identified in the procedure below
-		QString morpheme;
+		/// The start of the morpheme identified at the preceding step
+		/// (which ends where the candidate begins)
+		uint prev_begin(0);
 
-		/// Index along the current line
-		uint line_index(0);
+		/// A hapax which holds one or more morphemes
+		QStringView candidate;
 
 		/// The morpheme identified at the preceding step
-		QString prev("");
+		QStringView prev;
+
+		/// The morpheme identified in the procedure below
+		QStringView morpheme;
 
 		/// Characters preceding and following the left and right candidates
-		QString l_prev;
-		QString l_next;
-		QString r_prev;
-		QString r_next;
+		QChar l_prev;
+		QChar l_next;
+		QChar r_prev;
+		QChar r_next;
 
-		QString l_prev_1;
-		QString l_next_1;
-		QString r_prev_1;
-		QString r_next_1;
+		QChar l_prev_1;
+		QChar l_next_1;
+		QChar r_prev_1;
+		QChar r_next_1;
 
 		/////////////////////////////
 		/// The initial candidate ///
 		/////////////////////////////
 
-		QString left("");
-		QString right("");
+		QStringView left;
+		QStringView right;
+
+		/// The preceding morpheme followed by the left candidate
+		QStringView prev_left;
 
 		uint lp_count(0);
 		uint ls_count(0);
@@ -217,8 +270,9 @@ namespace Morpheus
 		/// Boundary one character to the right ///
 		///////////////////////////////////////////
 
-		QString left_1("");
-		QString right_1("");
+		QStringView left_1;
+		QStringView right_1;
+		QStringView prev_left_1;
 
 		uint lp_count_1(0);
 		uint ls_count_1(0);
@@ -235,58 +289,69 @@ namespace Morpheus
 		/// The size of the left candidate
 		uint left_size(0);
 
-		while ((!_reseg
-				&& line_index < line_size)
-			   || (_reseg
-				   && next_morph < line_seg.size()))
+		/// Cursors for the candidate, the growing left candidates (with
+		/// and without the preceding morpheme) and the shrinking right
+		/// candidates. The left cursors are narrowed by one character
+		/// per step rather than searched again from the first byte.
+		SuffixArray::Cursor cand_cursor;
+		SuffixArray::Cursor left_cursor;
+		SuffixArray::Cursor prev_left_cursor;
+		SuffixArray::Cursor right_cursor;
+		SuffixArray::Cursor left_1_cursor;
+		SuffixArray::Cursor prev_left_1_cursor;
+		SuffixArray::Cursor right_1_cursor;
+
+		/// The size of the left candidate which the cursors
+		/// correspond to (-1 if the cursors are stale)
+		int cursor_size(-1);
+
+		while (line_index < line_size)
 		{
-			if (!_reseg)
+			/// Collect characters until the string becomes a hapax legomenon.
+			/// The right candidate from the previous step is the starting point
+			/// (the whole candidate if the left candidate has run past its end).
+			int right_size(static_cast<int>(line_index - cand_begin) - static_cast<int>(left_size));
+			if (right_size < 0
+				|| right_size >= static_cast<int>(line_index - cand_begin))
 			{
-				/// Collect characters until the string becomes a hapax legomenon
-				right = candidate.right(candidate.size() - left_size);
-				do
-				{
-					candidate.push_back(_line.at(line_index));
-					right.push_back(_line.at(line_index));
-					++line_index;
-				} while (get_occurrences(right) > 1 &&
-						 line_index < _line.size());
-
-				/// Chop characters from the back until we have
-				/// two or more distinct predecessors
-				while (right.size() > 1
-					   && (get_distinct_predecessor_count(right) <= 1
-						   || get_distinct_successor_count(right) <= 1))
-				{
-					candidate.chop(1);
-					right.chop(1);
-					--line_index;
-				}
-
-				if (Config::console_output)
-				{
-					std::cout << "candidate: " << candidate.toUtf8().constData() << std::endl;
-					pause();
-				}
+				right_size = line_index - cand_begin;
 			}
-			else
+
+			uint right_begin(line_index - right_size);
+			SuffixArray::Cursor hapax_cursor(get_cursor(right_begin, line_index));
+			do
 			{
-				candidate.append(line_seg.at(next_morph++));
-				if (next_morph == 1
-					&& line_seg.size() > 1)
-				{
-					candidate.append(line_seg.at(next_morph++));
-				}
+				extend(hapax_cursor, line_index);
+				++line_index;
+			} while (get_occurrences(hapax_cursor) > 1 &&
+					 line_index < line_size);
+
+			/// Chop characters from the back until we have
+			/// two or more distinct predecessors
+			right = line.mid(right_begin, line_index - right_begin);
+			right_cursor = get_cursor(right_begin, line_index);
+			while (right.size() > 1
+				   && (get_distinct_predecessor_count(right, right_cursor) <= 1
+					   || get_distinct_successor_count(right, right_cursor) <= 1))
+			{
+				right = right.left(right.size() - 1);
+				--line_index;
+				right_cursor = get_cursor(right_begin, line_index);
+			}
 
-				if (Config::console_output)
-				{
-					std::cout << "reseg candidate: " << candidate.toUtf8().constData() << std::endl;
-					pause();
-				}
+			if (Trace)
+			{
+				std::cout << "candidate: " << line.mid(cand_begin, line_index - cand_begin).toUtf8().constData() << std::endl;
+				pause();
 			}
 
+			candidate = line.mid(cand_begin, line_index - cand_begin);
+			prev = line.mid(prev_begin, cand_begin - prev_begin);
+			cand_cursor = get_cursor(cand_begin, line_index);
+
 			/// The size of the left candidate
 			left_size = 0;
+			cursor_size = -1;
 
 			/// total_count_1 > total_count
 			bool up(false);
@@ -306,112 +371,145 @@ namespace Morpheus
 			/// Extract morphemes from the candidate
 			while (left_size <= candidate.size())
 			{
-				l_prev = "";
-				l_next = "";
-				r_prev = "";
-				r_next = "";
-				l_prev_1 = "";
-				l_next_1 = "";
-				r_prev_1 = "";
-				r_next_1 = "";
+				l_prev = QChar();
+				l_next = QChar();
+				r_prev = QChar();
+				r_next = QChar();
+				l_prev_1 = QChar();
+				l_next_1 = QChar();
+				r_prev_1 = QChar();
+				r_next_1 = QChar();
 
 				left = candidate.left(left_size);
-				right = candidate.right(candidate.size() - left_size);
+				right = candidate.mid(left_size);
+				prev_left = line.mid(prev_begin, prev.size() + left.size());
+
+				left_1 = candidate.left(left_size + (right.size() > 0 ? 1 : 0));
+				right_1 = candidate.mid(left_1.size());
+				prev_left_1 = line.mid(prev_begin, prev.size() + left_1.size());
+
+				if (cursor_size != static_cast<int>(left_size))
+				{
+					left_cursor = get_cursor(cand_begin, cand_begin + left_size);
+					prev_left_cursor = get_cursor(prev_begin, cand_begin + left_size);
+					right_cursor = get_cursor(cand_begin + left_size, line_index);
+				}
 
-				left_1 = left + right.left(1);
-				right_1 = candidate.right(candidate.size() - left_size - 1);
+				left_1_cursor = left_cursor;
+				prev_left_1_cursor = prev_left_cursor;
+				if (right.size() > 0)
+				{
+					extend(left_1_cursor, cand_begin + left_size);
+					extend(prev_left_1_cursor, cand_begin + left_size);
+				}
+				right_1_cursor = get_cursor(cand_begin + left_1.size(), line_index);
 
-				lp_count = get_distinct_predecessor_count(prev + left) + get_distinct_predecessor_count(left);
-				ls_count = get_distinct_successor_count(prev + left) + get_distinct_successor_count(left);
+				if (Trace)
+				{
+					lp_count = get_distinct_predecessor_count(prev_left, prev_left_cursor) + get_distinct_predecessor_count(left, left_cursor);
+				}
+				if (Trace || !Method::entropy)
+				{
+					ls_count = get_distinct_successor_count(prev_left, prev_left_cursor) + get_distinct_successor_count(left, left_cursor);
+				}
 
-				if (Config::seg_method_ps_entropy)
+				if (Method::entropy)
 				{
-					if (line_index - candidate.size() - prev.size() > 0)
+					if (prev_begin > 0)
 					{
-						l_prev = _line.mid(line_index - candidate.size() - prev.size() - 1, 1);
+						l_prev = line.at(prev_begin - 1);
 						l_prev_1 = l_prev;
 					}
 					if (right.size() > 0)
 					{
-						l_next = right.left(1);
+						l_next = right.at(0);
 					}
 
-					lp_ent = get_norm_predecessor_entropy(prev + left, l_prev);
-					ls_ent = get_norm_successor_entropy(prev + left, l_next);
-
-//					lp_ent = get_norm_predecessor_entropy(prev + left);
-//					ls_ent = get_norm_successor_entropy(prev + left);
+					lp_ent = get_norm_predecessor_entropy(prev_left, prev_left_cursor, l_prev);
+					ls_ent = get_norm_successor_entropy(prev_left, prev_left_cursor, l_next);
 				}
 
-				rp_count = get_distinct_predecessor_count(left + right) + get_distinct_predecessor_count(right);
-				rs_count = get_distinct_successor_count(left + right) + get_distinct_successor_count(right);
+				/// The left and right candidates together make up the candidate
+				if (Trace || !Method::entropy)
+				{
+					rp_count = get_distinct_predecessor_count(candidate, cand_cursor) + get_distinct_predecessor_count(right, right_cursor);
+				}
+				if (Trace)
+				{
+					rs_count = get_distinct_successor_count(candidate, cand_cursor) + get_distinct_successor_count(right, right_cursor);
+				}
 
-				if (Config::seg_method_ps_entropy)
+				if (Method::entropy)
 				{
 					if (left.size() > 0)
 					{
-						r_prev = left.right(1);
+						r_prev = left.at(left.size() - 1);
 					}
-					if (line_index < _line.size() - 1)
+					if (line_index + 1 < line_size)
 					{
-						r_next = _line.mid(line_index, 1);
+						r_next = line.at(line_index);
 						r_next_1 = r_next;
 					}
-					rp_ent = get_norm_predecessor_entropy(right, r_prev);
-					rs_ent = get_norm_successor_entropy(right, r_next);
-
-//					rp_ent = get_norm_predecessor_entropy(right);
-//					rs_ent = get_norm_successor_entropy(right);
+					rp_ent = get_norm_predecessor_entropy(right, right_cursor, r_prev);
+					rs_ent = get_norm_successor_entropy(right, right_cursor, r_next);
 				}
 
-				lp_count_1 = get_distinct_predecessor_count(prev + left_1) + get_distinct_predecessor_count(left_1);
-				ls_count_1 = get_distinct_successor_count(prev + left_1) + get_distinct_successor_count(left_1);
+				if (Trace)
+				{
+					lp_count_1 = get_distinct_predecessor_count(prev_left_1, prev_left_1_cursor) + get_distinct_predecessor_count(left_1, left_1_cursor);
+				}
+				if (Trace || !Method::entropy)
+				{
+					ls_count_1 = get_distinct_successor_count(prev_left_1, prev_left_1_cursor) + get_distinct_successor_count(left_1, left_1_cursor);
+				}
 
-				if (Config::seg_method_ps_entropy)
+				if (Method::entropy)
 				{
 					if (right_1.size() > 0)
 					{
-						l_next_1 = right_1.left(1);
+						l_next_1 = right_1.at(0);
 					}
 
-					lp_ent_1 = get_norm_predecessor_entropy(prev + left_1, l_prev_1);
-					ls_ent_1 = get_norm_successor_entropy(prev + left_1, l_next_1);
-
-//					lp_ent_1 = get_norm_predecessor_entropy(prev + left_1);
-//					ls_ent_1 = get_norm_successor_entropy(prev + left_1);
+					lp_ent_1 = get_norm_predecessor_entropy(prev_left_1, prev_left_1_cursor, l_prev_1);
+					ls_ent_1 = get_norm_successor_entropy(prev_left_1, prev_left_1_cursor, l_next_1);
 				}
 
-				rp_count_1 = get_distinct_predecessor_count(left_1 + right_1) + get_distinct_predecessor_count(right_1);
-				rs_count_1 = get_distinct_successor_count(left_1 + right_1) + get_distinct_successor_count(right_1);
+				if (Trace || !Method::entropy)
+				{
+					rp_count_1 = get_distinct_predecessor_count(candidate, cand_cursor) + get_distinct_predecessor_count(right_1, right_1_cursor);
+				}
+				if (Trace)
+				{
+					rs_count_1 = get_distinct_successor_count(candidate, cand_cursor) + get_distinct_successor_count(right_1, right_1_cursor);
+				}
 
-				if (Config::seg_method_ps_entropy)
+				if (Method::entropy)
 				{
 					if (left_1.size() > 0)
 					{
-						r_prev_1 = left_1.right(1);
+						r_prev_1 = left_1.at(left_1.size() - 1);
 					}
-					rp_ent_1 = get_norm_predecessor_entropy(right_1, r_prev_1);
-					rs_ent_1 = get_norm_successor_entropy(right_1, r_next_1);
-
-//					rp_ent_1 = get_norm_predecessor_entropy(right_1);
-//					rs_ent_1 = get_norm_successor_entropy(right_1);
+					rp_ent_1 = get_norm_predecessor_entropy(right_1, right_1_cursor, r_prev_1);
+					rs_ent_1 = get_norm_successor_entropy(right_1, right_1_cursor, r_next_1);
 				}
 
-				total_count = ls_count * rp_count/* + lp_count * rs_count*/;
-				total_count_1 = ls_count_1 * rp_count_1/* + lp_count_1 * rs_count_1*/;
-
-				if (Config::seg_method_ps_entropy)
+				if (Method::entropy)
 				{
 					total_ent = lp_ent + ls_ent + rp_ent + rs_ent;
 					total_ent_1 = lp_ent_1 + ls_ent_1 + rp_ent_1 + rs_ent_1;
 				}
+				else
+				{
+					total_count = ls_count * rp_count/* + lp_count * rs_count*/;
+					total_count_1 = ls_count_1 * rp_count_1/* + lp_count_1 * rs_count_1*/;
+				}
 
-				if (Config::console_output)
+				if (Trace)
 				{
 					std::cout << left_size
-							  << "\t" << (prev + "+" + left).toUtf8().constData()
+							  << "\t" << prev.toUtf8().constData() << "+" << left.toUtf8().constData()
 							  << "|" << right.toUtf8().constData();
-					if (Config::seg_method_ps_count)
+					if (!Method::entropy)
 					{
 						std::cout << "\t" << lp_count
 								  << "\t" << ls_count
@@ -420,7 +518,7 @@ namespace Morpheus
 								  << "\t(" << total_count << ")";
 					}
 
-					if (Config::seg_method_ps_entropy)
+					if (Method::entropy)
 					{
 						std::cout << "\t" << lp_ent
 								  << "\t" << ls_ent
@@ -430,10 +528,10 @@ namespace Morpheus
 					}
 					std::cout << std::endl;
 
-					std::cout << "\t" << (prev + "+" + left_1).toUtf8().constData()
+					std::cout << "\t" << prev.toUtf8().constData() << "+" << left_1.toUtf8().constData()
 							  << "|" << right_1.toUtf8().constData();
 
-					if (Config::seg_method_ps_count)
+					if (!Method::entropy)
 					{
 						std::cout << "\t" << lp_count_1
 								  << "\t" << ls_count_1
@@ -442,7 +540,7 @@ namespace Morpheus
 								  << "\t(" << total_count_1 << ")";
 					}
 
-					if (Config::seg_method_ps_entropy)
+					if (Method::entropy)
 					{
 						std::cout << "\t" << lp_ent_1
 								  << "\t" << ls_ent_1
@@ -453,19 +551,19 @@ namespace Morpheus
 
 					std::cout << std::endl;
 
-					if (Config::seg_method_ps_entropy)
+					if (Method::entropy)
 					{
-						std::cout << "l_prev: " << l_prev.toUtf8().constData()
-								  << "\tl_next: " << l_next.toUtf8().constData()
-								  << "\tr_prev: " << r_prev.toUtf8().constData()
-								  << "\tr_next: " << r_next.toUtf8().constData()
-								  << "l_prev_1: " << l_prev_1.toUtf8().constData()
-								  << "\tl_next_1: " << l_next_1.toUtf8().constData()
-								  << "\tr_prev_1: " << r_prev_1.toUtf8().constData()
-								  << "\tr_next_1: " << r_next_1.toUtf8().constData()
+						std::cout << "l_prev: " << QString(l_prev).toUtf8().constData()
+								  << "\tl_next: " << QString(l_next).toUtf8().constData()
+								  << "\tr_prev: " << QString(r_prev).toUtf8().constData()
+								  << "\tr_next: " << QString(r_next).toUtf8().constData()
+								  << "l_prev_1: " << QString(l_prev_1).toUtf8().constData()
+								  << "\tl_next_1: " << QString(l_next_1).toUtf8().constData()
+								  << "\tr_prev_1: " << QString(r_prev_1).toUtf8().constData()
+								  << "\tr_next_1: " << QString(r_next_1).toUtf8().constData()
 								  << std::endl
 
-								  << "\t" << (prev + "+" + left_1).toUtf8().constData()
+								  << "\t" << prev.toUtf8().constData() << "+" << left_1.toUtf8().constData()
 								  << "|" << right_1.toUtf8().constData()
 
 								  << "\t" << lp_count_1
@@ -480,74 +578,52 @@ namespace Morpheus
 
 				++left_size;
 
+				/// The extended cursors now match the next left candidate
+				left_cursor = left_1_cursor;
+				prev_left_cursor = prev_left_1_cursor;
+				right_cursor = right_1_cursor;
+				cursor_size = left_size;
+
 				//////////////////////
 				/// Detect valleys ///
 				//////////////////////
 
+				/// Compare the totals for this boundary and the next one
+				const bool falling(Method::entropy ? total_ent_1 < total_ent : total_count_1 < total_count);
+				const bool level(Method::entropy ? total_ent == total_ent_1 : total_count == total_count_1);
+
 				/// Detect a second peak
-				if (Config::seg_method_ps_count)
+				if (falling)
 				{
-					if (total_count_1 < total_count)
-					{
-						down = true;
-						if (up)
-						{
-							peak = true;
-						}
-					}
-					else if (total_count == total_count_1)
+					down = true;
+					if (up)
 					{
-						/// Plateau
-						if (prev.size() > 0)
-						{
-							left_size = 0;
-						}
-						prev.clear();
-						continue;
-					}
-					else
-					{
-						up = true;
-						if (down)
-						{
-							valley = true;
-							down = false;
-						}
+						peak = true;
 					}
 				}
-
-				else if (Config::seg_method_ps_entropy)
+				else if (level)
 				{
-					if (total_ent_1 < total_ent)
-					{
-						down = true;
-						if (up)
-						{
-							peak = true;
-						}
-					}
-					else if (total_ent == total_ent_1)
+					/// Plateau
+					if (prev.size() > 0)
 					{
-						/// Plateau
-						if (prev.size() > 0)
-						{
-							left_size = 0;
-						}
-						prev.clear();
-						continue;
+						left_size = 0;
+						cursor_size = -1;
 					}
-					else
+					prev_begin = cand_begin;
+					prev = QStringView();
+					continue;
+				}
+				else
+				{
+					up = true;
+					if (down)
 					{
-						up = true;
-						if (down)
-						{
-							valley = true;
-							down = false;
-						}
+						valley = true;
+						down = false;
 					}
 				}
 
-				if (Config::console_output)
+				if (Trace)
 				{
 					std::cout << "\tu: " << up
 							  << "\td: " << down
@@ -572,29 +648,24 @@ namespace Morpheus
 					}
 					else
 					{
-						if (peak)
-						{
-							morpheme = left;
-						}
-						else
-						{
-							morpheme = left_1;
-						}
+						morpheme = left;
 					}
 
 					/// The morpheme becomes the previous morpheme
 					/// for the next candidate.
-
+					prev_begin = cand_begin;
 					prev = morpheme;
 
 					/// Chop the current candidate at the end of the identified morpheme
-					candidate = candidate.right(candidate.size() - morpheme.size());
+					cand_begin += morpheme.size();
+					candidate = line.mid(cand_begin, line_index - cand_begin);
+					cand_cursor = get_cursor(cand_begin, line_index);
 
 					/// Append the identified morpheme to the temporary list
 					if (morpheme.trimmed().size() > 0)
 					{
-						tmp_dictionary.append(morpheme.trimmed());
-						if (Config::console_output)
+						tmp_dictionary.append(morpheme.trimmed().toString());
+						if (Trace)
 						{
 							std::cout << "morpheme: '" << morpheme.trimmed().toUtf8().constData() << "'" << std::endl;
 						}
@@ -602,6 +673,7 @@ namespace Morpheus
 
 					/// Clean up the variables
 					left_size = 0;
+					cursor_size = -1;
 					up = false;
 					down = false;
 					plateau = false;
@@ -609,13 +681,13 @@ namespace Morpheus
 					valley = false;
 
 					if (candidate.size() == 0
-						|| get_occurrences(candidate) > 1)
+						|| get_occurrences(cand_cursor) > 1)
 					{
 						break;
 					}
 				}
 
-				if (Config::console_output)
+				if (Trace)
 				{
 					pause();
 				}
@@ -626,111 +698,604 @@ namespace Morpheus
 				}
 			}
 		}
+
+		candidate = line.mid(cand_begin, line_index - cand_begin);
 		if (candidate.trimmed().size() > 0)
 		{
 			/// This makes sure that the candidate at the
 			/// end of the line is not omitted from the list
-			tmp_dictionary.append(candidate.trimmed());
-			if (Config::console_output)
+			tmp_dictionary.append(candidate.trimmed().toString());
+			if (Trace)
 			{
 				std::cout << "morpheme: '" << candidate.trimmed().toUtf8().constData() << "'" << std::endl;
 			}
 		}
 
-		/// Add the morphemes from the temporary list to the dictionary
-		for (const QString& m : tmp_dictionary)
+		return tmp_dictionary;
+	}
+
+	QString MorphemeExtractor::extract_morphemes(const QString&& _line)
+	{
+		const quint64 fingerprint(LineCache::fingerprint(_line));
+		const LineCache::Entry* cached(line_cache.find(_line, fingerprint));
+
+		QStringList morphemes;
+		if (cached)
+		{
+			/// Count the morphemes as if the line had been segmented again
+			morphemes = cached->morphemes;
+		}
+		else if (Options::seg_method_ps_count ||
+				 Options::seg_method_ps_entropy)
+		{
+			morphemes = extract_morphemes_ps(std::move(_line));
+		}
+		else if (Options::seg_method_character_frequencies)
+		{
+			morphemes = extract_morphemes_character_frequencies(std::move(_line));
+		}
+
+		/// Add the morphemes to the dictionary
+		for (const QString& m : morphemes)
 		{
-			++dictionary[m];
+			dictionary.increment(m);
 			++total_morpheme_count;
 		}
 
-		return tmp_dictionary.join(" ");
+		if (cached)
+		{
+			return cached->segmentation;
+		}
+
+		QString segmentation(morphemes.join(" "));
+		line_cache.insert(_line, fingerprint, morphemes, segmentation);
+		return segmentation;
 	}
 
-	QString MorphemeExtractor::extract_morphemes_character_frequencies(const QString&& _line)
+	QStringList MorphemeExtractor::extract_morphemes_ps(const QString&& _line)
 	{
-		return QString();
+		if (!ps_kernel)
+		{
+			select_ps_kernel();
+		}
+		return (this->*ps_kernel)(std::move(_line));
 	}
 
-	real MorphemeExtractor::get_dict_cost_split(const QString& _word,
-												const QString& _left,
-												const QString& _right)
+	void MorphemeExtractor::select_ps_kernel(const bool _trace)
 	{
-		real dict_cost_new(dict_cost - morpheme_cost[_word]);
+		if (Options::seg_method_ps_count)
+		{
+			ps_kernel = (_trace ? &MorphemeExtractor::extract_morphemes_ps<PSCount, true>
+								: &MorphemeExtractor::extract_morphemes_ps<PSCount, false>);
+		}
+		else
+		{
+			ps_kernel = (_trace ? &MorphemeExtractor::extract_morphemes_ps<PSEntropy, true>
+								: &MorphemeExtractor::extract_morphemes_ps<PSEntropy, false>);
+		}
+	}
 
-		if (!dictionary.contains(_left))
+	MorphemeExtractor::StringStats MorphemeExtractor::get_string_stats(const QString& _string,
+																	   const MorphemeDictionary& _dictionary)
+	{
+		const SuffixArray::Cursor cursor(sa->get_cursor(_string));
+
+		StringStats stats;
+		stats.occurrences = get_occurrences(cursor);
+		stats.distinct_predecessors = get_distinct_predecessor_count(_string, cursor);
+		stats.distinct_successors = get_distinct_successor_count(_string, cursor);
+		stats.predecessor_entropy = get_norm_predecessor_entropy(_string, cursor);
+		stats.successor_entropy = get_norm_successor_entropy(_string, cursor);
+		stats.morpheme_count = _dictionary.value(_string);
+		return stats;
+	}
+
+	uptr<MorphemeExtractor> MorphemeExtractor::make_staging() const
+	{
+		uptr<MorphemeExtractor> staging(make_worker());
+
+		staging->dictionary = dictionary;
+		staging->total_morpheme_count = total_morpheme_count;
+		staging->char_transition_count = char_transition_count;
+		staging->character_transitions = character_transitions;
+		staging->char_code_length = char_code_length;
+		staging->avg_char_prob = avg_char_prob;
+		staging->dict_cost = dict_cost;
+		staging->dict_entropy = dict_entropy;
+
+		/// Select the kernel (with the trace output if enabled) on first use
+		staging->ps_kernel = nullptr;
+
+		return staging;
+	}
+
+	void MorphemeExtractor::adopt(MorphemeExtractor& _staging)
+	{
+		std::swap(sa, _staging.sa);
+		std::swap(total_char_count, _staging.total_char_count);
+		std::swap(char_transition_count, _staging.char_transition_count);
+		std::swap(alphabet_ent, _staging.alphabet_ent);
+		std::swap(alphabet_norm_ent, _staging.alphabet_norm_ent);
+		std::swap(corpus_length, _staging.corpus_length);
+		std::swap(dict_cost, _staging.dict_cost);
+		std::swap(dict_entropy, _staging.dict_entropy);
+		std::swap(avg_char_prob, _staging.avg_char_prob);
+		std::swap(total_morpheme_count, _staging.total_morpheme_count);
+		std::swap(alphabet, _staging.alphabet);
+		dictionary.swap(_staging.dictionary);
+		std::swap(char_code_length, _staging.char_code_length);
+		std::swap(character_transitions, _staging.character_transitions);
+		std::swap(transition_pmi, _staging.transition_pmi);
+
+		/// The caches are keyed by suffix array intervals,
+		/// so they move with the suffix array
+		std::swap(p_cache, _staging.p_cache);
+		std::swap(s_cache, _staging.s_cache);
+		std::swap(p_ent_cache, _staging.p_ent_cache);
+		std::swap(s_ent_cache, _staging.s_ent_cache);
+		std::swap(string_cache, _staging.string_cache);
+		std::swap(line_cache, _staging.line_cache);
+
+		ps_kernel = nullptr;
+		dictionary_vector.clear();
+		alphabet_vector.clear();
+
+		emit morpheme_extractor_reset();
+	}
+
+	uptr<MorphemeExtractor> MorphemeExtractor::make_worker() const
+	{
+		uptr<MorphemeExtractor> worker(std::make_unique<MorphemeExtractor>());
+
+		worker->sa = sa;
+		worker->total_char_count = total_char_count;
+		worker->alphabet = alphabet;
+		worker->alphabet_ent = alphabet_ent;
+		worker->alphabet_norm_ent = alphabet_norm_ent;
+		worker->transition_pmi = transition_pmi;
+		worker->total_morpheme_count = 0;
+		worker->line_cache.reset(Options::line_cache_size);
+
+		/// The trace output and pausing do not work across threads
+		worker->select_ps_kernel(false);
+
+		return worker;
+	}
+
+	std::vector<QString> MorphemeExtractor::segment_parallel(const QStringList& _lines,
+															 const QString& _suffix,
+															 uint _threads,
+															 const bool _deterministic,
+															 const std::function<void(const uint, const uint)>& _progress,
+															 const CancellationToken& _cancel)
+	{
+		if (_threads == 0)
 		{
-			for (const QChar& ch : _left)
+			_threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		const uint line_count(_lines.size());
+
+		/// Without determinism, each thread takes one contiguous shard
+		/// and its dictionary grows over the whole shard as in serial extraction.
+		const uint shard_size(_deterministic ? parallel_block_size
+											 : std::max((line_count + _threads - 1) / _threads, 1u));
+		const uint shard_count((line_count + shard_size - 1) / shard_size);
+		_threads = std::max(std::min(_threads, shard_count), 1u);
+
+		std::vector<QString> segmented(line_count);
+		std::vector<uptr<MorphemeExtractor>> workers;
+
+		for (uint t = 0; t < _threads; ++t)
+		{
+			workers.push_back(make_worker());
+		}
+
+		std::atomic<uint> next_shard(0);
+		std::atomic<uint> lines_done(0);
+
+		auto run = [&](const uint _t)
+		{
+			MorphemeExtractor& worker(*workers[_t]);
+			uint shard;
+
+			while ((shard = next_shard++) < shard_count)
 			{
-				dict_cost_new += char_code_length[ch];
+				const uint first(shard * shard_size);
+				const uint last(std::min(first + shard_size, line_count));
+
+				if (_deterministic)
+				{
+					worker.dictionary.clear();
+					worker.line_cache.clear();
+				}
+
+				for (uint l = first; l < last; ++l)
+				{
+					if (_cancel.is_cancelled())
+					{
+						return;
+					}
+
+					segmented[l] = worker.extract_morphemes(_lines.at(l) + _suffix);
+					++lines_done;
+				}
 			}
+		};
+
+		std::vector<std::thread> threads;
+		for (uint t = 1; t < _threads; ++t)
+		{
+			threads.emplace_back(run, t);
 		}
 
-		if (!dictionary.contains(_right))
+		if (_progress)
 		{
-			for (const QChar& ch : _right)
+			/// Keep the calling thread free to report progress
+			threads.emplace_back(run, 0);
+			while (lines_done < line_count
+				   && !_cancel.is_cancelled())
 			{
-				dict_cost_new += char_code_length[ch];
+				_progress(lines_done, line_count);
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
 			}
+			_progress(lines_done, line_count);
+		}
+		else
+		{
+			run(0);
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
 		}
 
-		return dict_cost_new;
+		for (const uptr<MorphemeExtractor>& worker : workers)
+		{
+			line_cache.merge_statistics(worker->line_cache);
+		}
+
+		return segmented;
 	}
 
-	real MorphemeExtractor::get_dict_entropy_split(const QString& _word,
-												   const QString& _left,
-												   const QString& _right)
+	uint MorphemeExtractor::extract_morphemes(LineReader& _input,
+											  QTextStream& _output,
+											  uint _threads,
+											  const bool _deterministic,
+											  ullong& _chars,
+											  const std::function<void(const uint)>& _progress,
+											  const CancellationToken& _cancel)
 	{
-		real q((total_morpheme_count + dictionary[_word]) / static_cast<real>(total_morpheme_count));
+		if (_threads == 0)
+		{
+			_threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		/// Blocks which are being segmented or wait to be written
+		const uint max_blocks(2 * _threads);
 
-		/// The occurrences of the left and right candidates
-		uint l_occ(0);
-		uint r_occ(0);
-		if (dictionary.contains(_left))
+		std::vector<uptr<MorphemeExtractor>> workers;
+		for (uint t = 0; t < _threads; ++t)
 		{
-			l_occ = dictionary[_left];
+			workers.push_back(make_worker());
 		}
-		else
+
+		/// Blocks waiting for a worker and blocks which are done, by their index
+		std::deque<std::pair<uint, QStringList>> queued;
+		std::map<uint, QStringList> done;
+		std::mutex mutex;
+		std::condition_variable block_queued;
+		std::condition_variable block_done;
+		bool input_done(false);
+
+		auto run = [&](const uint _t)
 		{
-			l_occ = sa->get_occurrences(_left);
+			MorphemeExtractor& worker(*workers[_t]);
+			while (true)
+			{
+				std::pair<uint, QStringList> block;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					block_queued.wait(lock, [&]
+					{
+						return _cancel.is_cancelled()
+								|| input_done
+								|| !queued.empty();
+					});
+
+					if (_cancel.is_cancelled()
+						|| queued.empty())
+					{
+						return;
+					}
+					block = std::move(queued.front());
+					queued.pop_front();
+				}
+
+				/// In deterministic mode, each block starts afresh
+				/// and its morphemes are added to the dictionary of the thread
+				MorphemeDictionary block_dictionary;
+				if (_deterministic)
+				{
+					block_dictionary.swap(worker.dictionary);
+					worker.line_cache.clear();
+				}
+
+				for (QString& line : block.second)
+				{
+					if (_cancel.is_cancelled())
+					{
+						return;
+					}
+					line = worker.extract_morphemes(line + '\n');
+				}
+
+				if (_deterministic)
+				{
+					block_dictionary.merge(worker.dictionary);
+					worker.dictionary.swap(block_dictionary);
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				done.emplace(block.first, std::move(block.second));
+				block_done.notify_one();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (uint t = 0; t < _threads; ++t)
+		{
+			threads.emplace_back(run, t);
 		}
 
-		if (dictionary.contains(_right))
+		/// Read blocks of lines, and write the segmented blocks in their original order
+		uint line_count(0);
+		uint lines_written(0);
+		uint blocks_read(0);
+		uint blocks_written(0);
+		QString line;
+		while (!_cancel.is_cancelled())
 		{
-			r_occ = dictionary[_right];
+			while (!input_done
+				   && blocks_read - blocks_written < max_blocks)
+			{
+				QStringList block;
+				while (static_cast<uint>(block.size()) < parallel_block_size
+					   && (Options::max_lines == 0
+						   || line_count < Options::max_lines)
+					   && _input.read_line(line))
+				{
+					_chars += line.size();
+					++line_count;
+					block.append(line);
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				if (block.isEmpty())
+				{
+					input_done = true;
+				}
+				else
+				{
+					queued.emplace_back(blocks_read++, std::move(block));
+				}
+				block_queued.notify_all();
+			}
+
+			if (input_done
+				&& blocks_written == blocks_read)
+			{
+				break;
+			}
+
+			QStringList block;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+
+				/// Wake up now and then to check for cancellation
+				block_done.wait_for(lock, std::chrono::milliseconds(100), [&]
+				{
+					return done.count(blocks_written) > 0;
+				});
+
+				std::map<uint, QStringList>::iterator it(done.find(blocks_written));
+				if (it == done.end())
+				{
+					continue;
+				}
+				block = std::move(it->second);
+				done.erase(it);
+				++blocks_written;
+			}
+
+			for (const QString& segmented_line : block)
+			{
+				_output << segmented_line << '\n';
+			}
+			lines_written += block.size();
+
+			if (_progress)
+			{
+				_progress(lines_written);
+			}
 		}
-		else
+
+		/// Let the workers return
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			input_done = true;
+		}
+		block_queued.notify_all();
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		if (_cancel.is_cancelled())
+		{
+			return line_count;
+		}
+
+		/// Merge the worker dictionaries in a fixed order
+		for (const uptr<MorphemeExtractor>& worker : workers)
+		{
+			dictionary.merge(worker->dictionary);
+			total_morpheme_count += worker->total_morpheme_count;
+			line_cache.merge_statistics(worker->line_cache);
+		}
+
+		return line_count;
+	}
+
+	uint MorphemeExtractor::extract_morphemes_by_type(LineReader& _input,
+													  QTextStream& _output,
+													  const uint _threads,
+													  const bool _deterministic,
+													  ullong& _chars,
+													  const std::function<void(const uint, const uint)>& _progress,
+													  const CancellationToken& _cancel)
+	{
+		/// Collect the distinct tokens in order of first occurrence.
+		/// Only the types are kept: the lines are read again below.
+		const char* const first_line(_input.data() + _input.pos());
+		QHash<QString, uint> type_index;
+		QStringList types;
+		std::vector<uint> type_counts;
+		QString line;
+		uint line_count(0);
+		while ((Options::max_lines == 0
+				|| line_count < Options::max_lines)
+			   && _input.read_line(line))
+		{
+			_chars += line.size();
+			++line_count;
+			for (const QString& token : line.split(' ', skip_empty_parts))
+			{
+				const auto it(type_index.constFind(token));
+				if (it == type_index.constEnd())
+				{
+					type_index.insert(token, types.size());
+					types.append(token);
+					type_counts.push_back(1);
+				}
+				else
+				{
+					++type_counts[it.value()];
+				}
+			}
+		}
+
+		emit update_log("Distinct types: " + QString::number(types.size()));
+
+		/// Segment each type once. The dictionaries of the workers are
+		/// not used since they count each type only once.
+		std::vector<QString> segmented(segment_parallel(types, QString(), _threads, _deterministic, _progress, _cancel));
+		if (_cancel.is_cancelled())
+		{
+			return line_count;
+		}
+
+		/// The types are only needed again through type_index
+		types.clear();
+
+		/// Weight the morphemes of each type by the number of its occurrences
+		for (uint t = 0; t < segmented.size(); ++t)
+		{
+			const uint count(type_counts[t]);
+			for (const QString& morpheme : segmented[t].split(' ', skip_empty_parts))
+			{
+				dictionary.increment(morpheme, count);
+				total_morpheme_count += count;
+			}
+		}
+
+		/// Replay the segmentations over the corpus
+		const char* pos(first_line);
+		const char* end(_input.data() + _input.pos());
+		LineReader::Line input_line;
+		QStringList morphemes;
+		while (LineReader::next_line(pos, end, input_line))
 		{
-			r_occ = sa->get_occurrences(_right);
+			_input.decode(input_line, line);
+			morphemes.clear();
+			for (const QString& token : line.split(' ', skip_empty_parts))
+			{
+				const auto it(type_index.constFind(token));
+				morphemes.append(it == type_index.constEnd() ? token : segmented[it.value()]);
+			}
+			_output << morphemes.join(" ") << '\n';
 		}
+		return line_count;
+	}
 
-		std::cout << "left: " << _left.toUtf8().constData() << ", right: " << _right.toUtf8().constData() << std::endl;
+	QStringList MorphemeExtractor::extract_morphemes_character_frequencies(const QString&& _line)
+	{
+		/// A list holding the identified morphemes
+		/// in the order in which they appear in the current line
+		QStringList tmp_dictionary;
 
-		/// The occurrence probability of the word being split
-		real word_prob(dictionary[_word] / static_cast<real>(total_morpheme_count));
-		std::cout << "\tword_prob: " << word_prob << std::endl;
+		const int line_size(_line.size());
 
-		/// The first three elements
-		real old_ent_mod(dict_entropy + std::log1p(q) + word_prob * std::log(word_prob));
-		std::cout << "\told_ent_mod: " << old_ent_mod << std::endl;
+		/// PMI of the transition into the character at _pos.
+		/// There is no transition into the first character or past the end,
+		/// and a transition never seen in the corpus is a certain boundary
+		/// (even next to another one, which is not a local minimum).
+		auto pmi_at = [&](const int _pos)
+		{
+			if (_pos <= 0
+				|| _pos >= line_size)
+			{
+				return std::numeric_limits<real>::max();
+			}
+			hashmap<uint, real>::const_iterator it(transition_pmi.find(transition(_line.at(_pos - 1), _line.at(_pos))));
+			if (it == transition_pmi.end())
+			{
+				return std::numeric_limits<real>::lowest();
+			}
+			return it->second;
+		};
 
-		real log1(l_occ * std::log1p((l_occ + dictionary[_word]) / static_cast<real>(l_occ)));
-		std::cout << "\tlog1: " << log1 << std::endl;
+		/// The start of the current morpheme
+		int begin(0);
 
-		real log2(dictionary[_word] * std::log((l_occ + dictionary[_word]) / static_cast<real>(total_morpheme_count + dictionary[_word])));
-		std::cout << "\tlog2: " << log2 << std::endl;
+		/// PMI of the previous, current and next transitions
+		real prev_pmi(std::numeric_limits<real>::max());
+		real pmi(pmi_at(1));
+		real next_pmi(0.0);
 
-		real log3(r_occ * std::log1p((r_occ + dictionary[_word]) / static_cast<real>(r_occ)));
-		std::cout << "\tlog3: " << log3 << std::endl;
+		for (int pos = 1; pos <= line_size; ++pos)
+		{
+			next_pmi = pmi_at(pos + 1);
+
+			if (pos == line_size
+				|| _line.at(pos).isSpace()
+				|| _line.at(pos - 1).isSpace()
+				|| pmi == std::numeric_limits<real>::lowest()
+				|| (pmi < 0.0
+					&& pmi < prev_pmi
+					&& pmi <= next_pmi))
+			{
+				QString morpheme(_line.mid(begin, pos - begin).trimmed());
+				if (morpheme.size() > 0)
+				{
+					tmp_dictionary.append(morpheme);
+				}
+				begin = pos;
+			}
 
-		real log4(dictionary[_word] * std::log((r_occ + dictionary[_word]) / static_cast<real>(total_morpheme_count + dictionary[_word])));
-		std::cout << "\tlog4: " << log4 << std::endl;
+			prev_pmi = pmi;
+			pmi = next_pmi;
+		}
 
-		real sum((log1 + log2 + log3 + log4) / static_cast<real>(total_morpheme_count));
-		std::cout << "\tsum: " << sum << std::endl;
-		pause();
+		if (Options::console_output)
+		{
+			std::cout << "line: " << _line.toUtf8().constData() << std::endl
+					  << "morphemes: " << tmp_dictionary.join(" ").toUtf8().constData() << std::endl;
+		}
 
-		return ((old_ent_mod - sum) / q);
+		return tmp_dictionary;
 	}
 
 	void MorphemeExtractor::init_entropy()
@@ -743,189 +1308,180 @@ namespace Morpheus
 		/// Used to compute the dictionary entropy
 		real morpheme_prob(0.0);
 
-		for (const QString& m : dictionary.keys())
+		dictionary.for_each([&](const QString& m, const uint _count)
 		{
-			morpheme_cost[m] = 0.0;
-			for (const QChar& ch : m)
-			{
-				morpheme_cost[m] += char_code_length[ch];
-			}
-			dict_cost += morpheme_cost[m];
+			dict_cost += get_code_length(m);
 
 			/// Corpus entropy
-			morpheme_prob = dictionary[m] / static_cast<real>(total_morpheme_count);
+			morpheme_prob = _count / static_cast<real>(total_morpheme_count);
 			dict_entropy += -morpheme_prob * std::log(morpheme_prob);
+		});
+	}
+
+	QString MorphemeExtractor::segment_text(const QString& _text) const
+	{
+		DictionaryCosts costs(dictionary, char_code_length);
+		ViterbiSegmenter<DictionaryCosts> viterbi(costs);
+		return viterbi.segment(_text);
+	}
+
+	bool MorphemeExtractor::export_model(const QString& _filename)
+	{
+		/// The settings which affect segmentation
+		QList<QPair<QString, QString>> config;
+		config.append(qMakePair(QString("segmentation_method"), QString(Options::seg_method_ps_count ? "ps_count"
+																		: Options::seg_method_ps_entropy ? "ps_entropy"
+																		: "character_frequencies")));
+		config.append(qMakePair(QString("lowercase"), QString::number(Options::proc_lowercase)));
+		config.append(qMakePair(QString("remove_all_spaces"), QString::number(Options::proc_remove_all_spaces)));
+		config.append(qMakePair(QString("remove_non_alnum"), QString::number(Options::proc_remove_non_alnum)));
+		config.append(qMakePair(QString("remove_punctuation"), QString::number(Options::proc_remove_punctuation)));
+		config.append(qMakePair(QString("collapse_multiple_spaces"), QString::number(Options::proc_collapse_multiple_spaces)));
+		config.append(qMakePair(QString("keep_apostrophes"), QString::number(Options::proc_keep_apostrophes)));
+		config.append(qMakePair(QString("max_lines"), QString::number(Options::max_lines)));
+		config.append(qMakePair(QString("resegmentation_rounds"), QString::number(Options::resegmentation_rounds)));
+		config.append(qMakePair(QString("viterbi_resegmentation"), QString::number(Options::viterbi_resegmentation)));
+
+		QString error;
+		if (!FrozenModel::save(_filename, dictionary, char_code_length, config, error))
+		{
+			emit update_log("Cannot save the model to " + _filename + ": " + error);
+			return false;
 		}
+
+		emit update_log("Model saved to " + _filename + " (" + QString::number(dictionary.size()) + " morphemes)");
+		return true;
 	}
 
-	QString MorphemeExtractor::resegment_morphemes(const QString& _line)
+	uint MorphemeExtractor::resegment_morphemes(QTextStream& _input,
+												LineReader& _text,
+												QTextStream& _output,
+												const std::function<void(const uint, const real)>& _progress,
+												const CancellationToken& _cancel)
 	{
+		/// Resegmentation uses as many threads as extraction
+		Resegmenter resegmenter(char_code_length, Options::extraction_threads);
+
+		QString line;
+		while (_input.readLineInto(&line))
+		{
+			resegmenter.add_line(line);
+		}
+
+		const real initial_length(resegmenter.get_description_length());
+		const uint operations(resegmenter.run(Options::resegmentation_rounds, Options::resegmentation_seconds, _progress, _cancel));
+		if (_cancel.is_cancelled())
+		{
+			return 0;
+		}
+
+		/// Replace the dictionary with the resegmented one
+		resegmenter.fill(dictionary);
+		dictionary_vector.clear();
+		total_morpheme_count = resegmenter.get_total();
+		dict_cost = resegmenter.get_dict_cost();
+		dict_entropy = resegmenter.get_entropy();
 
-		QStringList morphemes(_line.split(" "));
-		QString new_line("");
-		QStringList candidate;
-		QString joined;
+		/// Cached segmentations no longer match the dictionary
+		line_cache.reset(Options::line_cache_size);
 
-		real old_entropy(0.0);
-		real new_entropy(0.0);
-		real old_cost(0.0);
-		real new_cost(0.0);
-		real p;
+		emit update_log("Resegmentation: " + QString::number(operations) + " operations in "
+						+ QString::number(resegmenter.get_rounds()) + " rounds"
+						+ (resegmenter.is_converged() ? "" : " (stopped by the budget)")
+						+ ", description length " + QString::number(initial_length, 'f', 1)
+						+ " -> " + QString::number(resegmenter.get_description_length(), 'f', 1));
 
-		do
+		if (!Options::viterbi_resegmentation)
 		{
-			for (const QString& str : morphemes)
+			for (uint l = 0; l < resegmenter.get_line_count(); ++l)
 			{
-				p = dictionary[str] / total_morpheme_count;
-				old_entropy -= p * std::log(p);
+				_output << resegmenter.get_segmentation(l) << '\n';
 			}
-
-			uint i(0);
-
-			do
+		}
+		else
+		{
+			/// Segment each word of the preprocessed text again with the
+			/// resegmented dictionary and count the morphemes of the result.
+			/// The segmented corpus has one line per preprocessed line but
+			/// no word boundaries, so they are taken from the text.
+			DictionaryCosts costs(dictionary, char_code_length);
+			ViterbiSegmenter<DictionaryCosts> viterbi(costs);
+			MorphemeDictionary decoded;
+			real corpus_cost(0.0);
+
+			QString text;
+			QString segmented;
+			auto count = [&](const QStringView _morpheme)
 			{
-				if (candidate.empty())
+				if (!segmented.isEmpty())
 				{
-					candidate.append(morphemes.at(i));
+					segmented.append(' ');
 				}
+				segmented.append(_morpheme.data(), _morpheme.size());
+				decoded.increment(_morpheme);
+			};
 
-				joined = candidate.join("");
+			for (uint l = 0; l < resegmenter.get_line_count(); ++l)
+			{
+				line = resegmenter.get_segmentation(l);
+				line.remove(' ');
+
+				/// Fall back to the line as a single word if the text
+				/// does not match the segmented corpus
+				bool matches(_text.read_line(text));
+				int pos(0);
+				for (int i = 0; matches && i < text.size(); ++i)
+				{
+					if (!text.at(i).isSpace())
+					{
+						matches = (pos < line.size()
+								   && text.at(i) == line.at(pos++));
+					}
+				}
 
-				std::cout << "Considering " << joined.toUtf8().constData() << std::endl;
+				if (!matches
+					|| pos != line.size())
+				{
+					text = line;
+				}
 
-				if (i < morphemes.size() - 1)
+				segmented.clear();
+				const int size(text.size());
+				int begin(0);
+				while (begin < size)
 				{
-					if (dictionary.contains(joined + morphemes.at(i + 1))
-						&& dictionary[joined + morphemes.at(i + 1)] > dictionary[joined])
+					while (begin < size
+						   && text.at(begin).isSpace())
 					{
-						candidate.append(morphemes.at(i + 1));
+						++begin;
 					}
-					else
+
+					int end(begin);
+					while (end < size
+						   && !text.at(end).isSpace())
 					{
-						new_line.append(candidate.join("") + " ");
+						++end;
+					}
 
-						++dictionary[candidate.join("")];
-						for (const QString& m : candidate)
-						{
-							--dictionary[m];
-							if (dictionary[m] == 0)
-							{
-								dictionary.remove(m);
-							}
-						}
-						candidate.clear();
+					if (end > begin)
+					{
+						corpus_cost += viterbi.segment_word(QStringView(text).mid(begin, end - begin), count);
 					}
+					begin = end;
 				}
-
-				++i;
-
-			} while (i < morphemes.size());
-
-			new_line.append(candidate.join(""));
-			morphemes.clear();
-			morphemes = new_line.split(" ");
-
-			extract_morphemes_ps(std::move(new_line), true);
-
-			for (const QString& str : morphemes)
-			{
-				p = dictionary[str] / total_morpheme_count;
-				new_entropy -= p * std::log(p);
+				_output << segmented << '\n';
 			}
 
-			if (Config::console_output)
-			{
-				std::cout << "Old entropy: " << old_entropy << ", new entropy: " << new_entropy << std::endl;
-				pause();
-			}
+			dictionary.swap(decoded);
+			total_morpheme_count = dictionary.get_total();
+			init_entropy();
 
-		} while (new_entropy > old_entropy);
-
-
-		/////////////////////////////////////////////
-
-		//		QMultiMap<uint, QString> morphemes_local;
-
-		//		for (const QString& str	: dictionary.keys())
-		//		{
-		//			morphemes_local.insert(dictionary[str], str);
-		//		}
-
-		//		/// Holds the current best segmentation.
-		//		/// The first element is the size of the left segment,
-		//		/// and the second holds a pair of the dictionary cost
-		//		/// and the dictionary entropy.
-		//		std::pair<int, std::pair<real, real>> best_segmentation(0, std::pair<real, real>(dict_cost, dict_entropy));
-
-		//		QVector<QString> matches_left;
-		//		QVector<QString> matches_right;
-
-		//		QMultiMap<uint, QString>::const_iterator mit(morphemes_local.cend());
-
-		//		while (mit != morphemes_local.cbegin())
-		//		{
-		//			const QString& pattern(mit.value());
-
-		//			QString left;
-		//			QString right;
-
-		//			for (const QString& target : dictionary.keys())
-		//			{
-		//				if (dictionary[target] != 0
-		//					&& target.size() > pattern.size())
-		//				{
-		//					if (target.left(pattern.size()) == pattern)
-		//					{
-		//						matches_left.push_back(target);
-		//					}
-		//					else if (target.right(pattern.size()) == pattern)
-		//					{
-		//						matches_right.push_back(target);
-		//					}
-		//				}
-		//			}
-
-		//			if (best_segmentation.first != 0)
-		//			{
-		//				/// Insert the new entries into the dictionary
-		//				left = pattern.left(best_segmentation.first);
-		//				right = pattern.right(pattern.size() - left.size());
-
-		//				if (Config::console_output)
-		//				{
-		//					std::cout << "\t\tSegmenting '" << pattern.toUtf8().constData()
-		//							  << "'' into '" << left.toUtf8().constData()
-		//							  << "' and '" << right.toUtf8().constData() << "'" << std::endl;
-
-		//					pause();
-		//				}
-
-		//				dictionary[left] += dictionary[pattern];
-		//				dictionary[right] += dictionary[pattern];
-
-		//				/// Update the morpheme count
-		//				total_morpheme_count += dictionary[pattern];
-
-		//				/// Update the dictionary cost, corpus entropy and effort
-		//				dict_cost = best_segmentation.second.first;
-		//				dict_entropy = best_segmentation.second.second;
-
-		//				/// Remove the current morpheme from the dictionary
-		//				dictionary.remove(mit.value());
-
-		//				/// Reset the best segmentation
-		//				best_segmentation.first = 0;
-		//			}
-		//			--mit;
-		//		}
-
-		//		if (Config::console_output)
-		//		{
-		//			std::cout << std::endl << "Done!" << std::endl;
-		//		}
-		emit morphemes_resegmented();
+			emit update_log("Viterbi pass: " + QString::number(dictionary.size()) + " morphemes, corpus cost "
+							+ QString::number(corpus_cost, 'f', 1));
+		}
 
-		return new_line;
+		emit morphemes_resegmented();
 
+		return resegmenter.get_line_count();
 	}
 }
@@ -1,8 +1,16 @@
 #ifndef MORPHEMEEXTRACTOR_HPP
 #define MORPHEMEEXTRACTOR_HPP
 #include "Globals.hpp"
-#include "Config.hpp"
+#include "Options.hpp"
+#include "CancellationToken.hpp"
 #include "SuffixArray.hpp"
+#include "Entropy.hpp"
+#include "LineCache.hpp"
+#include "LineReader.hpp"
+#include "MorphemeDictionary.hpp"
+#include "Resegmenter.hpp"
+#include "ViterbiSegmenter.hpp"
+#include "FrozenModel.hpp"
 
 namespace Morpheus
 {
@@ -42,53 +50,108 @@ namespace Morpheus
 			QHash<QChar, uint> alphabet;
 
 			/// All extracted morphemes
-			QHash<QString, uint> dictionary;
+			MorphemeDictionary dictionary;
 
 			/// Entropy of each character
 			QHash<QChar, real> char_code_length;
 
-			/// Morpheme cost in terms of character entropy
-			QHash<QString, real> morpheme_cost;
+			/// Character transitions (keyed by transition())
+			hashmap<uint, uint> character_transitions;
 
-			/// Character transitions
-			QHash<QChar, QHash<QChar, uint>> character_transitions;
+			/// Pointwise mutual information of each character transition
+			hashmap<uint, real> transition_pmi;
 
-			/// Number of predecessors
-			QHash<QString, uint> p_cache;
+			/// The UTF-8 bytes of the lines added since begin_corpus()
+			std::vector<uchar> corpus_bytes;
 
-			/// Number of successors
-			QHash<QString, uint> s_cache;
+			///
+			/// \brief Key for a transition from one character to the next
+			/// \param _first
+			/// \param _second
+			/// \return
+			///
+			static inline uint transition(const QChar _first,
+										  const QChar _second)
+			{
+				return (static_cast<uint>(_first.unicode()) << 16) | _second.unicode();
+			}
 
-			/// Entropy of predecessors
-			QHash<QString, real> p_ent_cache;
+			/// Number of predecessors (keyed by suffix array interval)
+			SuffixArray::interval_map<uint> p_cache;
 
-			/// Entropy of successors
-			QHash<QString, real> s_ent_cache;
+			/// Number of successors (keyed by suffix array interval)
+			SuffixArray::interval_map<uint> s_cache;
+
+			/// Entropy of predecessors (keyed by suffix array interval and context character)
+			SuffixArray::interval_map<real> p_ent_cache;
+
+			/// Entropy of successors (keyed by suffix array interval and context character)
+			SuffixArray::interval_map<real> s_ent_cache;
 
 			/// Temporary dictionary of string occurrences
 			QHash<QString, uint> string_cache;
 
+			/// Segmentations of recently seen lines
+			LineCache line_cache;
+
 			/// Suffix array instance for searching
-			uptr<SuffixArray> sa;
+			/// (shared read-only with parallel workers)
+			sptr<SuffixArray> sa;
+
+			/// The current line encoded as UTF-8
+			std::vector<uchar> line_bytes;
+
+			/// Byte offset of each character in the current line
+			std::vector<uint> line_offsets;
+
+			/// Buffer for predecessor and successor counts
+			SuffixArray::Counts neighbour_counts;
+
+			///
+			/// \brief Return a cursor for the characters [_begin, _end)
+			/// of the current line
+			/// \param _begin
+			/// \param _end
+			/// \return
+			///
+			inline SuffixArray::Cursor get_cursor(const uint _begin,
+												  const uint _end)
+			{
+				return sa->get_cursor(line_bytes.data() + line_offsets[_begin],
+									  line_bytes.data() + line_offsets[_end]);
+			}
+
+			///
+			/// \brief Extend a cursor by the character at _pos in the current line
+			/// \param _cursor
+			/// \param _pos
+			///
+			inline void extend(SuffixArray::Cursor& _cursor,
+							   const uint _pos)
+			{
+				sa->extend(_cursor,
+						   line_bytes.data() + line_offsets[_pos],
+						   line_bytes.data() + line_offsets[_pos + 1]);
+			}
 
 			///
 			/// \brief Find the total number of predecessors of the	search string
-			/// \param _string
+			/// \param _cursor
 			/// \return
 			///
-			inline uint get_total_predecessor_count(const QString& _string)
+			inline uint get_total_predecessor_count(const SuffixArray::Cursor& _cursor)
 			{
-				return sa->get_total_predecessor_count(std::move(_string));
+				return sa->get_total_predecessor_count(_cursor);
 			}
 
 			///
 			/// \brief Find the total number of successors of the search string
-			/// \param _string
+			/// \param _cursor
 			/// \return
 			///
-			inline uint get_total_successor_count(const QString& _string)
+			inline uint get_total_successor_count(const SuffixArray::Cursor& _cursor)
 			{
-				return sa->get_total_successor_count(std::move(_string));
+				return sa->get_total_successor_count(_cursor);
 			}
 
 			///
@@ -96,17 +159,32 @@ namespace Morpheus
 			/// \param _string
 			/// \return
 			///
-			inline uint get_distinct_predecessor_count(const QString& _string)
+			inline uint get_distinct_predecessor_count(const QStringView _string)
+			{
+				return get_distinct_predecessor_count(_string, sa->get_cursor(_string));
+			}
+
+			///
+			/// \brief Find the number of distinct predecessors of the search string,
+			/// using a cursor already positioned at the string
+			/// \param _string
+			/// \param _cursor
+			/// \return
+			///
+			inline uint get_distinct_predecessor_count(const QStringView _string,
+													   const SuffixArray::Cursor& _cursor)
 			{
 				if (_string.size() == 0)
 				{
 					return alphabet.size();
 				}
-				else if (!p_cache.contains(_string))
+
+				SuffixArray::interval_map<uint>::const_iterator it(p_cache.find(_cursor.key()));
+				if (it != p_cache.end())
 				{
-					p_cache[_string] = sa->get_distinct_predecessor_count(std::move(_string));
+					return it->second;
 				}
-				return p_cache[_string];
+				return p_cache[_cursor.key()] = sa->count_predecessors(_cursor, neighbour_counts);
 			}
 
 			///
@@ -114,53 +192,87 @@ namespace Morpheus
 			/// \param _string
 			/// \return
 			///
-			inline uint get_distinct_successor_count(const QString& _string)
+			inline uint get_distinct_successor_count(const QStringView _string)
+			{
+				return get_distinct_successor_count(_string, sa->get_cursor(_string));
+			}
+
+			///
+			/// \brief Find the number of distinct successors of the search string,
+			/// using a cursor already positioned at the string
+			/// \param _string
+			/// \param _cursor
+			/// \return
+			///
+			inline uint get_distinct_successor_count(const QStringView _string,
+													 const SuffixArray::Cursor& _cursor)
 			{
 				if (_string.size() == 0)
 				{
 					return alphabet.size();
 				}
-				else if (!s_cache.contains(_string))
+
+				SuffixArray::interval_map<uint>::const_iterator it(s_cache.find(_cursor.key()));
+				if (it != s_cache.end())
 				{
-					s_cache[_string] = sa->get_distinct_successor_count(std::move(_string));
+					return it->second;
 				}
-				return s_cache[_string];
+				return s_cache[_cursor.key()] = sa->count_successors(_cursor, neighbour_counts);
 			}
 
 			///
 			/// \brief Compute the entropy of the predecessors of the search string
 			/// \param _string
-			/// \param _ch: predecessor
+			/// \param _cursor
+			/// \param _ch: predecessor (null for the entropy of all predecessors)
 			/// \return
 			///
-			real get_predecessor_entropy(const QString& _string,
-												const QString& _ch = "");
+			real get_predecessor_entropy(const QStringView _string,
+										 const SuffixArray::Cursor& _cursor,
+										 const QChar _ch = QChar());
 
 			///
 			/// \brief Compute the entropy of the successors of the search string
 			/// \param _string
-			/// \param _ch: successor
+			/// \param _cursor
+			/// \param _ch: successor (null for the entropy of all successors)
+			/// \return
+			///
+			real get_successor_entropy(const QStringView _string,
+									   const SuffixArray::Cursor& _cursor,
+									   const QChar _ch = QChar());
+
+			///
+			/// \brief Compute the *normalised* entropy of the predecessors of the search string
+			/// \param _string
+			/// \param _ch: predecessor
 			/// \return
 			///
-			real get_successor_entropy(const QString& _string,
-											  const QString& _ch = "");
+			inline real get_norm_predecessor_entropy(const QStringView _string,
+													 const QChar _ch = QChar())
+			{
+				return get_norm_predecessor_entropy(_string, sa->get_cursor(_string), _ch);
+			}
 
 			///
 			/// \brief Compute the *normalised* entropy of the predecessors of the search string
+			/// using a cursor already positioned at the string
 			/// \param _string
+			/// \param _cursor
 			/// \param _ch: predecessor
 			/// \return
 			///
-			inline real get_norm_predecessor_entropy(const QString& _string,
-													 const QString& _ch = "")
+			inline real get_norm_predecessor_entropy(const QStringView _string,
+													 const SuffixArray::Cursor& _cursor,
+													 const QChar _ch = QChar())
 			{
-				if ((_ch + _string).size() == 0
-					|| get_total_predecessor_count(_string) == 0)
+				if ((_ch.isNull() && _string.size() == 0)
+					|| get_total_predecessor_count(_cursor) == 0)
 				{
 					return alphabet_norm_ent;
 				}
-				real p_total(get_total_predecessor_count(_string));
-				return (get_predecessor_entropy(_string, _ch) / (p_total > 1 ? static_cast<real>(std::log2(p_total) ) : 1.0 ) );
+				real p_total(get_total_predecessor_count(_cursor));
+				return (get_predecessor_entropy(_string, _cursor, _ch) / (p_total > 1 ? static_cast<real>(std::log2(p_total) ) : 1.0 ) );
 			}
 
 			///
@@ -169,16 +281,31 @@ namespace Morpheus
 			/// \param _ch: successor
 			/// \return
 			///
-			inline real get_norm_successor_entropy(const QString& _string,
-												   const QString& _ch = "")
+			inline real get_norm_successor_entropy(const QStringView _string,
+												   const QChar _ch = QChar())
 			{
-				if ((_string + _ch).size() == 0
-					|| get_total_successor_count(_string) == 0)
+				return get_norm_successor_entropy(_string, sa->get_cursor(_string), _ch);
+			}
+
+			///
+			/// \brief Compute the *normalised* entropy of the successors of the search string
+			/// using a cursor already positioned at the string
+			/// \param _string
+			/// \param _cursor
+			/// \param _ch: successor
+			/// \return
+			///
+			inline real get_norm_successor_entropy(const QStringView _string,
+												   const SuffixArray::Cursor& _cursor,
+												   const QChar _ch = QChar())
+			{
+				if ((_ch.isNull() && _string.size() == 0)
+					|| get_total_successor_count(_cursor) == 0)
 				{
 					return alphabet_norm_ent;
 				}
-				real p_total(get_total_successor_count(_string));
-				return (get_successor_entropy(_string, _ch) / (p_total > 1 ? static_cast<real>(std::log2(p_total) ) : 1.0 ) );
+				real p_total(get_total_successor_count(_cursor));
+				return (get_successor_entropy(_string, _cursor, _ch) / (p_total > 1 ? static_cast<real>(std::log2(p_total) ) : 1.0 ) );
 			}
 
 			///
@@ -195,6 +322,17 @@ namespace Morpheus
 				return string_cache[_string];
 			}
 
+			///
+			/// \brief Find occurrences of the string at the cursor.
+			/// This is simply the size of the interval, so no cache is involved.
+			/// \param _cursor
+			/// \return
+			///
+			inline uint get_occurrences(const SuffixArray::Cursor& _cursor) const
+			{
+				return sa->get_occurrences(_cursor);
+			}
+
 			///
 			/// \brief get_description_length
 			/// \param _string
@@ -211,7 +349,7 @@ namespace Morpheus
 					}
 					return -std::log(norm / static_cast<real>(total_char_count));
 				}
-				return -std::log(dictionary[_string] / static_cast<real>(dictionary.size()));
+				return -std::log(dictionary.value(_string) / static_cast<real>(dictionary.size()));
 			}
 
 			///
@@ -229,69 +367,119 @@ namespace Morpheus
 				return 0.0;
 			}
 
+			/// Segmentation by predecessor / successor counts
+			struct PSCount
+			{
+					static constexpr bool entropy = false;
+			};
+
+			/// Segmentation by predecessor / successor entropy
+			struct PSEntropy
+			{
+					static constexpr bool entropy = true;
+			};
+
 			///
-			/// \brief Extract morphemes based on predecessor / successor counts and/or entropy.
-			///	ps = predecessors & successors
+			/// \brief Extract morphemes based on predecessor / successor counts or entropy.
+			///	ps = predecessors & successors.
+			/// The method and the trace output are fixed at compile time
+			/// so that each specialisation only does the work it needs.
+			/// The morphemes are not added to the dictionary.
 			/// \param _line
-			/// \return
+			/// \return The morphemes in the order in which they appear in the line
 			///
-			QString extract_morphemes_ps(const QString&& _line,
-										 const bool _reseg = false);
+			template <typename Method, bool Trace>
+			QStringList extract_morphemes_ps(const QString&& _line);
+
+			/// The specialisation of extract_morphemes_ps for the current run
+			QStringList (MorphemeExtractor::*ps_kernel)(const QString&&) = nullptr;
 
 			///
-			/// \brief Extract morphemes based on character frequencies
-			/// \param _line
-			/// \return
+			/// \brief Pick the specialisation of extract_morphemes_ps
+			/// matching the current settings
+			/// \param _trace: whether to print the trace output
 			///
-			QString extract_morphemes_character_frequencies(const QString&& _line);
+			void select_ps_kernel(const bool _trace = Options::console_output);
+
+			/// Lines per block in parallel extraction
+			static constexpr uint parallel_block_size = 256;
 
 			///
-			/// \brief Computes the new dictionary cost for a potential split
-			/// \param _word
-			/// \param _left
-			/// \param _right
-			/// \return
+			/// \brief Segment a list of lines (or word types) on several threads
+			/// (see extract_morphemes_by_type()). In deterministic mode, the lines
+			/// are split into blocks of parallel_block_size lines which start
+			/// with an empty dictionary; otherwise each thread takes one shard.
+			/// \param _lines
+			/// \param _suffix: appended to each line before segmentation
+			/// \param _threads
+			/// \param _deterministic
+			/// \param _progress
+			/// \param _cancel: checked before each line
+			/// \return The segmented lines in their original order
 			///
-			real get_dict_cost_split(const QString& _word,
-									 const QString& _left,
-									 const QString& _right);
+			std::vector<QString> segment_parallel(const QStringList& _lines,
+												  const QString& _suffix,
+												  uint _threads,
+												  const bool _deterministic,
+												  const std::function<void(const uint, const uint)>& _progress,
+												  const CancellationToken& _cancel);
 
 			///
-			/// \brief Computes the new corpus entropy for a potential split
-			/// \param _word
-			/// \param _left
-			/// \param _right
-			/// \return
+			/// \brief Extract morphemes based on predecessor / successor counts or entropy
+			/// using the specialisation selected for the current run
+			/// \param _line
+			/// \return The morphemes in the line
 			///
-			real get_dict_entropy_split(const QString& _word,
-										  const QString& _left,
-										  const QString& _right);
-
+			QStringList extract_morphemes_ps(const QString&& _line);
 
 			///
-			/// \brief Computes the new dictionary cost for a potential merge
-			/// \param _word
-			/// \param _left
-			/// \param _right
-			/// \return
+			/// \brief Extract morphemes based on character frequencies.
+			/// This is a single pass over the line without any suffix array queries:
+			/// a boundary is placed at each local minimum of the pointwise mutual
+			/// information of adjacent characters which is below zero
+			/// (i.e., where the two characters co-occur less often than by chance).
+			/// \param _line
+			/// \return The morphemes in the line
 			///
-			real get_dict_cost_merge(const QString& _word,
-									 const QString& _left,
-									 const QString& _right);
+			QStringList extract_morphemes_character_frequencies(const QString&& _line);
 
 			///
-			/// \brief Computes the new corpus entropy for a potential merge
-			/// \param _word
-			/// \param _left
-			/// \param _right
+			/// \brief Cost of spelling out a string in terms of character entropy
+			/// \param _string
 			/// \return
 			///
-			real get_corpus_entropy_merge(const QString& _word,
-										  const QString& _left,
-										  const QString& _right);
+			inline real get_code_length(const QStringView _string) const
+			{
+				real length(0.0);
+				for (const QChar ch : _string)
+				{
+					length += char_code_length.value(ch);
+				}
+				return length;
+			}
 
 		public:
 
+			///
+			/// \brief Corpus statistics of a string
+			///
+			struct StringStats
+			{
+					/// Occurrences in the processed corpus
+					uint occurrences;
+
+					/// Number of distinct characters before and after the string
+					uint distinct_predecessors;
+					uint distinct_successors;
+
+					/// Normalised entropy of the characters before and after the string
+					real predecessor_entropy;
+					real successor_entropy;
+
+					/// Count of the string as a morpheme in the dictionary
+					uint morpheme_count;
+			};
+
 			MorphemeExtractor()
 			{
 
@@ -302,6 +490,32 @@ namespace Morpheus
 
 			}
 
+			///
+			/// \brief Create a worker for parallel extraction. The worker shares
+			/// the suffix array and the character statistics with this extractor
+			/// but has its own caches and dictionary.
+			/// \return
+			///
+			uptr<MorphemeExtractor> make_worker() const;
+
+			///
+			/// \brief Create an extractor to run a stage on without changing
+			/// this one. It shares the suffix array and starts with copies of
+			/// the character statistics and the dictionary.
+			/// The results are taken over with adopt().
+			/// \return
+			///
+			uptr<MorphemeExtractor> make_staging() const;
+
+			///
+			/// \brief Take over the suffix array, the statistics, the dictionary
+			/// and the caches of a staging extractor (see make_staging()).
+			/// The previous state is left in _staging.
+			/// Must be called on the thread which reads this extractor.
+			/// \param _staging
+			///
+			void adopt(MorphemeExtractor& _staging);
+
 			///
 			/// \brief Return the total number of characters in the corpus
 			/// \return
@@ -338,6 +552,24 @@ namespace Morpheus
 				return static_cast<uint>(dictionary.size());
 			}
 
+			///
+			/// \brief Return the number of lines found in the line cache
+			/// \return
+			///
+			inline uint get_line_cache_hits() const
+			{
+				return line_cache.get_hits();
+			}
+
+			///
+			/// \brief Return the number of lines looked up in the line cache
+			/// \return
+			///
+			inline uint get_line_cache_lookups() const
+			{
+				return line_cache.get_lookups();
+			}
+
 			///
 			/// \brief Return the alphabet
 			/// (distinct characters with their counts)
@@ -353,7 +585,12 @@ namespace Morpheus
 			/// (distinct morphemes with their counts)
 			/// \return
 			///
-			inline QHash<QString,uint>& get_dictionary()
+			inline MorphemeDictionary& get_dictionary()
+			{
+				return dictionary;
+			}
+
+			inline const MorphemeDictionary& get_dictionary() const
 			{
 				return dictionary;
 			}
@@ -365,40 +602,148 @@ namespace Morpheus
 			QVector<QPair<QChar,uint>> alphabet_vector;
 
 			///
-			/// \brief Vector holding the dictionary.
+			/// \brief Dictionary nodes from the most to the least frequent.
 			/// Used for fast viewing and sorting in tables.
 			///
-			QVector<QPair<QString,uint>> dictionary_vector;
+			std::vector<uint> dictionary_vector;
 
 			///
-			/// \brief Extract the characters from the preprocessed corpus.
-			/// \param _processed_file
+			/// \brief Start loading a corpus which is passed in with add_line().
+			/// The corpus is only read once: the characters are counted as
+			/// the lines are added, and the suffix array is built over them
+			/// by end_corpus().
 			///
-			void extract_characters(const QString& _processed_file);
+			void begin_corpus();
+
+			///
+			/// \brief Add a preprocessed line to the corpus
+			/// \param _line: without the line break
+			///
+			void add_line(const QString& _line);
+
+			///
+			/// \brief Build the suffix array over the lines added since
+			/// begin_corpus() and compute the character statistics
+			/// \param _progress: receives progress reports while the suffix array is built
+			/// \param _cancel: stops the construction of the suffix array
+			/// \return Whether the corpus was loaded (false if cancelled)
+			///
+			bool end_corpus(ProgressSink& _progress = ProgressSink::none(),
+							const CancellationToken& _cancel = CancellationToken::none());
 
 			///
 			/// \brief Extract morphemes - interface function
 			/// \param _line
 			/// \return
 			///
-			QString extract_morphemes(const QString&& _line)
-			{
-				if (Config::seg_method_ps_count ||
-					Config::seg_method_ps_entropy)
-				{
-					return extract_morphemes_ps(std::move(_line));
-				}
-				else if (Config::seg_method_character_frequencies)
-				{
-					return extract_morphemes_character_frequencies(std::move(_line));
-				}
-				return QString();
-			}
+			QString extract_morphemes(const QString&& _line);
+
+			///
+			/// \brief Extract morphemes from the lines of a file in parallel.
+			/// The lines are read in blocks which are segmented by separate
+			/// workers, and each block is written as soon as the blocks before
+			/// it have been written, so at most two blocks per thread are held
+			/// in memory. The dictionaries of the workers are merged into this
+			/// one at the end.
+			/// In deterministic mode, each block starts with an empty dictionary,
+			/// so the output does not depend on the number of threads.
+			/// At most Options::max_lines lines are read (all if it is 0).
+			/// \param _input
+			/// \param _output: receives the segmented lines in their original order
+			/// \param _threads: number of threads (0 for all available cores)
+			/// \param _deterministic
+			/// \param _chars: incremented by the number of characters read
+			/// \param _progress: called on the calling thread with the number of lines written
+			/// \param _cancel: checked before each line. If it is set,
+			/// the output is incomplete and the dictionary is not changed.
+			/// \return The number of lines read
+			///
+			uint extract_morphemes(LineReader& _input,
+								   QTextStream& _output,
+								   uint _threads,
+								   const bool _deterministic,
+								   ullong& _chars,
+								   const std::function<void(const uint)>& _progress = nullptr,
+								   const CancellationToken& _cancel = CancellationToken::none());
+
+			///
+			/// \brief Extract morphemes by word type. The distinct space-delimited
+			/// tokens are collected in a first pass over the lines and segmented
+			/// once each (in parallel). The segmented lines are then written
+			/// in a second pass by replaying the segmentation of each token,
+			/// and the dictionary counts are weighted by the token counts.
+			/// Only the types are held in memory.
+			/// At most Options::max_lines lines are read (all if it is 0).
+			/// \param _input
+			/// \param _output: receives the segmented lines in their original order
+			/// \param _threads: number of threads (0 for all available cores)
+			/// \param _deterministic
+			/// \param _chars: incremented by the number of characters read
+			/// \param _progress: called on the calling thread with the number of types done and the total
+			/// \param _cancel: checked before each type. If it is set,
+			/// nothing is written and the dictionary is not changed.
+			/// \return The number of lines read
+			///
+			uint extract_morphemes_by_type(LineReader& _input,
+										   QTextStream& _output,
+										   const uint _threads,
+										   const bool _deterministic,
+										   ullong& _chars,
+										   const std::function<void(const uint, const uint)>& _progress = nullptr,
+										   const CancellationToken& _cancel = CancellationToken::none());
+
+			///
+			/// \brief Optimises the current segmentation by minimising
+			/// its description length (see Resegmenter).
+			/// If Options::viterbi_resegmentation is set, each word of the
+			/// preprocessed text is then segmented again with a Viterbi pass
+			/// over the new dictionary.
+			/// The dictionary is replaced with the resegmented one.
+			/// Lines are streamed in and out, and only their morpheme ids
+			/// are held in memory in between.
+			/// \param _input: segmented lines (morphemes separated by spaces)
+			/// \param _text: the preprocessed lines which were segmented,
+			/// read only for the Viterbi pass
+			/// \param _output: receives the resegmented lines
+			/// \param _progress: called every 1000 operations with the number
+			/// of operations so far and the current description length
+			/// \param _cancel: checked before each batch of operations.
+			/// If it is set, nothing is written and the dictionary is not changed.
+			/// \return The number of lines
+			///
+			uint resegment_morphemes(QTextStream& _input,
+									 LineReader& _text,
+									 QTextStream& _output,
+									 const std::function<void(const uint, const real)>& _progress = nullptr,
+									 const CancellationToken& _cancel = CancellationToken::none());
+
+			///
+			/// \brief Segment text with the current dictionary (see ViterbiSegmenter).
+			/// Only the dictionary and the character code lengths are used,
+			/// so the text need not be part of the corpus.
+			/// \param _text: whitespace-delimited words
+			/// \return Morphemes separated by spaces
+			///
+			QString segment_text(const QString& _text) const;
+
+			///
+			/// \brief Look up a string in the suffix array and a dictionary.
+			/// The suffix array results are cached as during extraction.
+			/// \param _string
+			/// \param _dictionary: supplies the morpheme count
+			/// (a worker has no dictionary of its own)
+			/// \return
+			///
+			StringStats get_string_stats(const QString& _string,
+										 const MorphemeDictionary& _dictionary);
 
 			///
-			/// \brief Optimises the current segmentation.
+			/// \brief Save the dictionary, the character code lengths
+			/// and the current settings as a model file (see FrozenModel)
+			/// \param _filename
+			/// \return Whether the model was saved
 			///
-			QString resegment_morphemes(const QString& _line);
+			bool export_model(const QString& _filename);
 
 			///
 			/// \brief Computes the initial dictionary cost and entropy
@@ -431,8 +776,13 @@ namespace Morpheus
 				s_ent_cache.clear();
 				string_cache.clear();
 
+				/// The settings may have changed since the last run
+				ps_kernel = nullptr;
+
 				if (_clear_morphemes)
 				{
+					/// Cached segmentations depend on the dictionary
+					line_cache.reset(Options::line_cache_size);
 					dictionary_vector.clear();
 					dictionary.clear();
 					total_morpheme_count = 0;
@@ -456,16 +806,17 @@ namespace Morpheus
 			}
 
 			///
-			/// \brief Initialise the morpheme extractor
+			/// \brief Initialise the morpheme extractor from a preprocessed corpus
+			/// (see begin_corpus())
 			/// \param _processed_file
-			///
-			inline void init(const QString& _processed_file)
-			{
-				reset();
-				sa = std::make_unique<SuffixArray>();
-				sa->set_filenames(_processed_file);
-				extract_characters(_processed_file);
-			}
+			/// \param _progress: receives progress reports while the suffix array is built
+			/// \param _cancel: stops the construction of the suffix array
+			/// and the reading of the corpus
+			/// \return Whether the extractor was initialised (false if cancelled)
+			///
+			bool init(const QString& _processed_file,
+					  ProgressSink& _progress = ProgressSink::none(),
+					  const CancellationToken& _cancel = CancellationToken::none());
 
 	};
 }
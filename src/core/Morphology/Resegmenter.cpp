@@ -0,0 +1,777 @@
+#include "Resegmenter.hpp"
+
+namespace Morpheus
+{
+	constexpr real Resegmenter::min_gain;
+	constexpr uint Resegmenter::no_morpheme;
+	constexpr uint Resegmenter::lines_per_worker;
+
+	real Resegmenter::code_length(const QStringView _str) const
+	{
+		real length(0.0);
+		for (const QChar ch : _str)
+		{
+			length += char_code_length.value(ch);
+		}
+		return length;
+	}
+
+	void Resegmenter::set_count(const uint _id,
+								const uint _count)
+	{
+		uint old(morphemes.count(_id));
+		if (old == _count)
+		{
+			return;
+		}
+
+		count_cost += Entropy::n_log_n(_count) - Entropy::n_log_n(old);
+		total = total - old + _count;
+
+		if (old == 0)
+		{
+			dict_cost += code_length(morphemes.morpheme(_id));
+		}
+		else if (_count == 0)
+		{
+			dict_cost -= code_length(morphemes.morpheme(_id));
+		}
+
+		morphemes.set_count(_id, _count);
+	}
+
+	std::vector<uint> Resegmenter::get_line(const uint _line) const
+	{
+		hashmap<uint, std::vector<uint>>::const_iterator it(overlay.find(_line));
+		if (it != overlay.end())
+		{
+			return it->second;
+		}
+		return std::vector<uint>(tokens.begin() + offsets[_line], tokens.begin() + offsets[_line + 1]);
+	}
+
+	void Resegmenter::count_pairs(const std::vector<uint>& _line,
+								  const int _sign)
+	{
+		for (uint t = 1; t < _line.size(); ++t)
+		{
+			quint64 key(pair(_line[t - 1], _line[t]));
+			if (_sign > 0)
+			{
+				++pairs[key];
+			}
+			else
+			{
+				hashmap<quint64, uint>::iterator it(pairs.find(key));
+				if (it != pairs.end()
+					&& --it->second == 0)
+				{
+					pairs.erase(it);
+				}
+			}
+		}
+	}
+
+	real Resegmenter::split_gain(const uint _id,
+								 const QString& _word,
+								 const real _cost,
+								 const int _length) const
+	{
+		const uint c(morphemes.count(_id));
+		if (c == 0)
+		{
+			return 0.0;
+		}
+
+		const QStringView left(QStringView(_word).left(_length));
+		const QStringView right(QStringView(_word).mid(_length));
+		const uint cl(count_of(find(left)));
+		const uint cr(count_of(find(right)));
+
+		real d_dict(-_cost);
+		real d_count(-Entropy::n_log_n(c));
+
+		if (left == right)
+		{
+			d_count += Entropy::n_log_n(cl + 2 * c) - Entropy::n_log_n(cl);
+			if (cl == 0)
+			{
+				d_dict += code_length(left);
+			}
+		}
+		else
+		{
+			d_count += Entropy::n_log_n(cl + c) - Entropy::n_log_n(cl)
+					   + Entropy::n_log_n(cr + c) - Entropy::n_log_n(cr);
+			if (cl == 0)
+			{
+				d_dict += code_length(left);
+			}
+			if (cr == 0)
+			{
+				d_dict += code_length(right);
+			}
+		}
+
+		/// Every occurrence of the word becomes two morphemes
+		real d_corpus(Entropy::n_log_n(total + c) - Entropy::n_log_n(total) - d_count);
+
+		return -(d_dict + d_corpus);
+	}
+
+	Resegmenter::Candidate Resegmenter::best_split(const uint _id) const
+	{
+		Candidate best{0.0, _id, 0, false};
+		const QString word(morphemes.morpheme(_id));
+		const real cost(code_length(word));
+
+		for (int length = 1; length < word.size(); ++length)
+		{
+			/// Do not split surrogate pairs
+			if (word.at(length - 1).isHighSurrogate())
+			{
+				continue;
+			}
+
+			real gain(split_gain(_id, word, cost, length));
+			if (best.second == 0
+				|| gain > best.gain)
+			{
+				best.gain = gain;
+				best.second = length;
+			}
+		}
+		return best;
+	}
+
+	real Resegmenter::merge_gain(const uint _left,
+								 const uint _right,
+								 const uint _count) const
+	{
+		const uint cl(morphemes.count(_left));
+		const uint cr(morphemes.count(_right));
+		const uint needed(_left == _right ? 2 * _count : _count);
+		if (_count == 0
+			|| cl < needed
+			|| cr < needed)
+		{
+			return 0.0;
+		}
+
+		const QString word(morphemes.morpheme(_left));
+		QString joined(word);
+		morphemes.append(_right, joined);
+		const uint cj(count_of(find(joined)));
+
+		real d_dict(cj == 0 ? code_length(joined) : 0.0);
+		real d_count(Entropy::n_log_n(cj + _count) - Entropy::n_log_n(cj));
+
+		if (_left == _right)
+		{
+			d_count += Entropy::n_log_n(cl - needed) - Entropy::n_log_n(cl);
+			if (cl == needed)
+			{
+				d_dict -= code_length(word);
+			}
+		}
+		else
+		{
+			d_count += Entropy::n_log_n(cl - _count) - Entropy::n_log_n(cl)
+					   + Entropy::n_log_n(cr - _count) - Entropy::n_log_n(cr);
+			if (cl == _count)
+			{
+				d_dict -= code_length(word);
+			}
+			if (cr == _count)
+			{
+				d_dict -= code_length(QStringView(joined).mid(word.size()));
+			}
+		}
+
+		/// Each merged pair becomes one morpheme
+		real d_corpus(Entropy::n_log_n(total - _count) - Entropy::n_log_n(total) - d_count);
+
+		return -(d_dict + d_corpus);
+	}
+
+	uint Resegmenter::count_repeats(const uint _id)
+	{
+		uint repeats(0);
+		hashset<uint> seen;
+		for (const uint line : lines_of[_id])
+		{
+			if (!seen.insert(line).second)
+			{
+				continue;
+			}
+
+			/// Occurrences are merged from left to right,
+			/// so a run of r occurrences yields r / 2 merges
+			uint run(0);
+			for (const uint t : get_line(line))
+			{
+				if (t == _id)
+				{
+					++run;
+				}
+				else
+				{
+					repeats += run / 2;
+					run = 0;
+				}
+			}
+			repeats += run / 2;
+		}
+		return repeats;
+	}
+
+	real Resegmenter::rescore(Candidate& _candidate)
+	{
+		if (_candidate.merge)
+		{
+			uint count(0);
+			if (_candidate.first == _candidate.second)
+			{
+				count = count_repeats(_candidate.first);
+			}
+			else
+			{
+				hashmap<quint64, uint>::const_iterator it(pairs.find(pair(_candidate.first, _candidate.second)));
+				count = (it == pairs.end() ? 0 : it->second);
+			}
+			_candidate.gain = merge_gain(_candidate.first, _candidate.second, count);
+		}
+		else
+		{
+			_candidate = best_split(_candidate.first);
+		}
+		return _candidate.gain;
+	}
+
+	void Resegmenter::push_merge(const uint _left,
+								 const uint _right)
+	{
+		Candidate candidate{0.0, _left, _right, true};
+		rescore(candidate);
+		push(candidate);
+	}
+
+	Resegmenter::Operation Resegmenter::resolve(const Candidate& _candidate)
+	{
+		if (_candidate.merge)
+		{
+			QString joined(morphemes.morpheme(_candidate.first));
+			morphemes.append(_candidate.second, joined);
+			return Operation{true, intern(joined), _candidate.first, _candidate.second};
+		}
+
+		const QString word(morphemes.morpheme(_candidate.first));
+		const uint left(intern(QStringView(word).left(_candidate.second)));
+		const uint right(intern(QStringView(word).mid(_candidate.second)));
+		return Operation{false, _candidate.first, left, right};
+	}
+
+	void Resegmenter::rewrite(const Operation& _op,
+							  std::vector<uint>& _line,
+							  uint& _rewrites)
+	{
+		std::vector<uint> now;
+		now.reserve(_line.size() + 1);
+
+		for (uint t = 0; t < _line.size(); ++t)
+		{
+			if (_op.merge)
+			{
+				if (_line[t] == _op.left
+					&& t + 1 < _line.size()
+					&& _line[t + 1] == _op.right)
+				{
+					now.push_back(_op.word);
+					++_rewrites;
+					++t;
+				}
+				else
+				{
+					now.push_back(_line[t]);
+				}
+			}
+			else
+			{
+				if (_line[t] == _op.word)
+				{
+					now.push_back(_op.left);
+					now.push_back(_op.right);
+					++_rewrites;
+				}
+				else
+				{
+					now.push_back(_line[t]);
+				}
+			}
+		}
+
+		_line.swap(now);
+	}
+
+	void Resegmenter::apply(const std::vector<Operation>& _batch,
+							hashset<quint64>& _touched,
+							hashset<uint>& _dirty)
+	{
+		operations += _batch.size();
+
+		/// Only lines containing both morphemes of a merge can change,
+		/// so it is enough to visit the lines of either of them
+		std::vector<uint> scans;
+		scans.reserve(_batch.size());
+		for (const Operation& op : _batch)
+		{
+			scans.push_back(!op.merge ? op.word
+									  : (lines_of[op.left].size() <= lines_of[op.right].size() ? op.left : op.right));
+		}
+
+		/// The operations to apply to each affected line
+		std::vector<uint> lines;
+		hashmap<uint, std::vector<uint>> line_ops;
+		for (uint o = 0; o < _batch.size(); ++o)
+		{
+			for (const uint line : lines_of[scans[o]])
+			{
+				std::vector<uint>& ops(line_ops[line]);
+				if (ops.empty())
+				{
+					lines.push_back(line);
+				}
+				if (ops.empty()
+					|| ops.back() != o)
+				{
+					ops.push_back(o);
+				}
+			}
+		}
+
+		const uint worker_count(std::max(std::min<uint>(threads, lines.size() / lines_per_worker), 1u));
+		std::vector<Delta> deltas(worker_count);
+
+		auto work = [&](const uint _w)
+		{
+			Delta& delta(deltas[_w]);
+			delta.rewrites.assign(_batch.size(), 0);
+
+			const uint first(static_cast<quint64>(lines.size()) * _w / worker_count);
+			const uint last(static_cast<quint64>(lines.size()) * (_w + 1) / worker_count);
+
+			for (uint l = first; l < last; ++l)
+			{
+				const uint line(lines[l]);
+				const std::vector<uint>& ops(line_ops.at(line));
+				const std::vector<uint> old(get_line(line));
+				std::vector<uint> now(old);
+
+				for (const uint o : ops)
+				{
+					rewrite(_batch[o], now, delta.rewrites[o]);
+				}
+
+				/// Drop stale entries from the inverted index
+				for (const uint o : ops)
+				{
+					if (std::find(now.begin(), now.end(), scans[o]) == now.end())
+					{
+						delta.removed.emplace_back(scans[o], line);
+					}
+				}
+
+				if (now == old)
+				{
+					continue;
+				}
+
+				for (uint t = 1; t < old.size(); ++t)
+				{
+					--delta.pairs[pair(old[t - 1], old[t])];
+				}
+				for (uint t = 1; t < now.size(); ++t)
+				{
+					++delta.pairs[pair(now[t - 1], now[t])];
+				}
+
+				/// Record the new morphemes and the pairs around them
+				for (const uint o : ops)
+				{
+					const Operation& op(_batch[o]);
+					for (const uint m : {op.merge ? op.word : op.left, op.merge ? op.word : op.right})
+					{
+						bool present(false);
+						for (uint t = 0; t < now.size(); ++t)
+						{
+							if (now[t] == m)
+							{
+								present = true;
+								if (t > 0)
+								{
+									delta.touched.insert(pair(now[t - 1], m));
+								}
+								if (t + 1 < now.size())
+								{
+									delta.touched.insert(pair(m, now[t + 1]));
+								}
+							}
+						}
+
+						if (present)
+						{
+							delta.added.emplace_back(m, line);
+						}
+					}
+				}
+
+				delta.lines.emplace_back(line, std::move(now));
+			}
+		};
+
+		std::vector<std::thread> workers;
+		for (uint w = 1; w < worker_count; ++w)
+		{
+			workers.emplace_back(work, w);
+		}
+		work(0);
+		for (std::thread& worker : workers)
+		{
+			worker.join();
+		}
+
+		/// Merge the deltas. The changes to each pair are summed over
+		/// all workers first, so a pair is never decremented before
+		/// another worker's increment has been applied.
+		hashmap<uint, hashset<uint>> removed;
+		hashmap<quint64, int> pair_changes;
+		for (Delta& delta : deltas)
+		{
+			for (const std::pair<const quint64, int>& p : delta.pairs)
+			{
+				pair_changes[p.first] += p.second;
+			}
+
+			for (std::pair<uint, std::vector<uint>>& line : delta.lines)
+			{
+				overlay[line.first] = std::move(line.second);
+			}
+
+			for (const std::pair<uint, uint>& entry : delta.added)
+			{
+				if (lines_of[entry.first].empty()
+					|| lines_of[entry.first].back() != entry.second)
+				{
+					lines_of[entry.first].push_back(entry.second);
+				}
+			}
+
+			for (const std::pair<uint, uint>& entry : delta.removed)
+			{
+				removed[entry.first].insert(entry.second);
+			}
+
+			_touched.insert(delta.touched.begin(), delta.touched.end());
+		}
+
+		for (const std::pair<const quint64, int>& p : pair_changes)
+		{
+			if (p.second > 0)
+			{
+				pairs[p.first] += p.second;
+			}
+			else if (p.second < 0)
+			{
+				/// Only pairs in the old lines are removed, and those are counted
+				hashmap<quint64, uint>::iterator it(pairs.find(p.first));
+				Q_ASSERT(it != pairs.end()
+						 && it->second >= static_cast<uint>(-p.second));
+				if (it == pairs.end())
+				{
+					continue;
+				}
+
+				if (it->second <= static_cast<uint>(-p.second))
+				{
+					pairs.erase(it);
+				}
+				else
+				{
+					it->second -= -p.second;
+				}
+			}
+		}
+
+		for (const std::pair<const uint, hashset<uint>>& entry : removed)
+		{
+			std::vector<uint>& index(lines_of[entry.first]);
+			index.erase(std::remove_if(index.begin(), index.end(), [&](const uint _line)
+			{
+				return entry.second.count(_line) > 0;
+			}), index.end());
+		}
+
+		for (uint o = 0; o < _batch.size(); ++o)
+		{
+			const Operation& op(_batch[o]);
+
+			uint rewrites(0);
+			for (const Delta& delta : deltas)
+			{
+				rewrites += delta.rewrites[o];
+			}
+
+			if (op.merge)
+			{
+				set_count(op.left, morphemes.count(op.left) - rewrites);
+				set_count(op.right, morphemes.count(op.right) - rewrites);
+				set_count(op.word, morphemes.count(op.word) + rewrites);
+			}
+			else
+			{
+				set_count(op.word, morphemes.count(op.word) - rewrites);
+				set_count(op.left, morphemes.count(op.left) + rewrites);
+				set_count(op.right, morphemes.count(op.right) + rewrites);
+			}
+
+			for (const uint m : {op.word, op.left, op.right})
+			{
+				_dirty.insert(m);
+				if (morphemes.count(m) == 0)
+				{
+					lines_of.erase(m);
+				}
+			}
+		}
+	}
+
+	void Resegmenter::clear()
+	{
+		morphemes.clear();
+		lines_of.clear();
+		pairs.clear();
+		tokens.clear();
+		offsets.assign(1, 0);
+		overlay.clear();
+		operations = 0;
+		rounds = 0;
+		converged = false;
+		dict_cost = 0.0;
+		count_cost = 0.0;
+		total = 0;
+		queue = heap<Candidate>();
+	}
+
+	void Resegmenter::add_line(const QString& _line)
+	{
+		const uint line_index(offsets.size() - 1);
+		const uint begin(tokens.size());
+
+		for (const QString& morpheme : _line.split(' ', skip_empty_parts))
+		{
+			uint id(intern(morpheme));
+			set_count(id, morphemes.count(id) + 1);
+
+			std::vector<uint>& lines(lines_of[id]);
+			if (lines.empty()
+				|| lines.back() != line_index)
+			{
+				lines.push_back(line_index);
+			}
+
+			if (tokens.size() > begin)
+			{
+				++pairs[pair(tokens.back(), id)];
+			}
+			tokens.push_back(id);
+		}
+		offsets.push_back(tokens.size());
+	}
+
+	void Resegmenter::revisit(const hashset<uint>& _dirty)
+	{
+		hashset<uint> lines;
+		hashset<quint64> seen;
+
+		for (const uint id : _dirty)
+		{
+			if (morphemes.count(id) == 0)
+			{
+				continue;
+			}
+
+			push_split(id);
+
+			for (const uint line : lines_of[id])
+			{
+				if (!lines.insert(line).second)
+				{
+					continue;
+				}
+
+				const std::vector<uint> tokens_in_line(get_line(line));
+				for (uint t = 1; t < tokens_in_line.size(); ++t)
+				{
+					if (seen.insert(pair(tokens_in_line[t - 1], tokens_in_line[t])).second)
+					{
+						push_merge(tokens_in_line[t - 1], tokens_in_line[t]);
+					}
+				}
+			}
+		}
+	}
+
+	uint Resegmenter::run(const uint _max_rounds,
+						  const uint _max_seconds,
+						  const std::function<void(const uint, const real)>& _progress,
+						  const CancellationToken& _cancel)
+	{
+		const uint start(operations);
+		const std::chrono::steady_clock::time_point started(std::chrono::steady_clock::now());
+		hashset<quint64> touched;
+		hashset<uint> dirty;
+
+		const uint batch_size(threads == 1 ? 1 : 16 * threads);
+		std::vector<Operation> batch;
+		hashset<uint> used;
+
+		rounds = 0;
+		converged = false;
+		queue = heap<Candidate>();
+
+		/// The first round scores every morpheme and pair
+		for (uint id = 1; id < morphemes.get_node_count(); ++id)
+		{
+			if (morphemes.count(id) > 0)
+			{
+				push_split(id);
+			}
+		}
+
+		for (const auto& p : pairs)
+		{
+			push_merge(static_cast<uint>(p.first >> 32), static_cast<uint>(p.first & 0xFFFFFFFF));
+		}
+
+		while (!queue.empty())
+		{
+			++rounds;
+			dirty.clear();
+
+			while (!queue.empty())
+			{
+				if (_cancel.is_cancelled()
+					|| (_max_seconds > 0
+						&& std::chrono::steady_clock::now() - started >= std::chrono::seconds(_max_seconds)))
+				{
+					queue = heap<Candidate>();
+					return operations - start;
+				}
+
+				/// Collect a batch of the best operations
+				/// (a single one when running on one thread)
+				batch.clear();
+				used.clear();
+				while (!queue.empty()
+					   && batch.size() < batch_size)
+				{
+					Candidate candidate(queue.top());
+					queue.pop();
+
+					/// The gain may be out of date
+					if (rescore(candidate) <= min_gain)
+					{
+						continue;
+					}
+
+					if (!queue.empty()
+						&& candidate.gain < queue.top().gain)
+					{
+						queue.push(candidate);
+						continue;
+					}
+
+					/// Operations in a batch must not share morphemes.
+					/// The batch ends at the first conflict to keep to the order of the gains.
+					const Operation op(resolve(candidate));
+					if (used.count(op.word) > 0
+						|| used.count(op.left) > 0
+						|| used.count(op.right) > 0)
+					{
+						queue.push(candidate);
+						break;
+					}
+
+					used.insert(op.word);
+					used.insert(op.left);
+					used.insert(op.right);
+					batch.push_back(op);
+				}
+
+				if (batch.empty())
+				{
+					continue;
+				}
+
+				const uint before(operations);
+				touched.clear();
+				apply(batch, touched, dirty);
+
+				/// Queue the operations affected by the changes
+				for (const Operation& op : batch)
+				{
+					push_split(op.word);
+					push_split(op.left);
+					push_split(op.right);
+				}
+
+				for (const quint64 key : touched)
+				{
+					push_merge(static_cast<uint>(key >> 32), static_cast<uint>(key & 0xFFFFFFFF));
+				}
+
+				if (_progress
+					&& (operations - start) / 1000 > (before - start) / 1000)
+				{
+					_progress(operations - start, get_description_length());
+				}
+			}
+
+			if (_max_rounds > 0
+				&& rounds >= _max_rounds)
+			{
+				return operations - start;
+			}
+
+			/// Changes in the counts can make operations worthwhile
+			/// which were not queued at the time
+			revisit(dirty);
+		}
+
+		converged = true;
+		return operations - start;
+	}
+
+	QString Resegmenter::get_segmentation(const uint _line) const
+	{
+		QString str;
+		for (const uint id : get_line(_line))
+		{
+			if (!str.isEmpty())
+			{
+				str.append(' ');
+			}
+			morphemes.append(id, str);
+		}
+		return str;
+	}
+
+	void Resegmenter::fill(MorphemeDictionary& _dictionary) const
+	{
+		_dictionary.clear();
+		morphemes.for_each([&](const QString& _morpheme, const uint _count)
+		{
+			_dictionary.increment(_morpheme, _count);
+		});
+	}
+}
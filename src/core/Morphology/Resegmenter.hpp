@@ -0,0 +1,394 @@
+#ifndef RESEGMENTER_HPP
+#define RESEGMENTER_HPP
+
+#include "Globals.hpp"
+#include "Entropy.hpp"
+#include "MorphemeDictionary.hpp"
+#include "CancellationToken.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief Global resegmentation by minimum description length.
+	///
+	/// The description length of a segmented corpus is
+	/// L = D + N ln N - sum(c_m ln c_m),
+	/// where D is the cost of spelling out every morpheme in the dictionary
+	/// (the sum of the character code lengths) and the remaining terms are
+	/// the cost of the corpus given the morpheme counts c_m (N = sum(c_m)).
+	///
+	/// Candidate operations are splits of a morpheme into two
+	/// and merges of two adjacent morphemes. They are held in a priority
+	/// queue ordered by their gain (the decrease in L) and applied
+	/// best first. Gains are recomputed when a candidate reaches the top
+	/// of the queue, so stale entries need not be removed. Each operation
+	/// only rewrites the lines which contain the morphemes involved
+	/// (found through an inverted index), and D, N and the sum of c ln c
+	/// are updated as counts change.
+	///
+	/// Work proceeds in rounds. The first round scores every morpheme and
+	/// pair. Each later round only revisits the lines containing a morpheme
+	/// whose count changed in the previous round, so its cost scales with
+	/// the amount of change rather than with the size of the corpus.
+	/// Resegmentation stops when a round changes nothing or a budget runs out.
+	///
+	/// With more than one thread, operations are applied in batches
+	/// of operations which share no morphemes (so they commute).
+	/// The affected lines are split into shards, and each worker rewrites
+	/// its shard and collects the changes to the counts, the pairs and
+	/// the inverted index in a Delta. The deltas are merged after each batch.
+	///
+	class Resegmenter
+	{
+		private:
+
+			/// Operations with a gain below this are ignored
+			static constexpr real min_gain = 1e-6;
+
+			/// Marks a missing morpheme
+			static constexpr uint no_morpheme = MorphemeDictionary::no_node;
+
+			/// Minimum number of affected lines per worker
+			static constexpr uint lines_per_worker = 256;
+
+			struct Candidate
+			{
+					/// Decrease in the description length
+					real gain;
+
+					/// Merge: the left and right morphemes.
+					/// Split: the morpheme and the length of the left part.
+					uint first;
+					uint second;
+
+					bool merge;
+
+					inline bool operator < (const Candidate& _other) const
+					{
+						return gain < _other.gain;
+					}
+			};
+
+			///
+			/// \brief A candidate with its morphemes resolved.
+			/// Merge: left + right -> word. Split: word -> left + right.
+			///
+			struct Operation
+			{
+					bool merge;
+					uint word;
+					uint left;
+					uint right;
+			};
+
+			///
+			/// \brief Changes made by one worker while applying a batch
+			///
+			struct Delta
+			{
+					/// Changes in the pair counts
+					hashmap<quint64, int> pairs;
+
+					/// Number of rewrites by each operation in the batch
+					std::vector<uint> rewrites;
+
+					/// Rewritten lines
+					std::vector<std::pair<uint, std::vector<uint>>> lines;
+
+					/// (morpheme, line) entries to add to the inverted index
+					std::vector<std::pair<uint, uint>> added;
+
+					/// (morpheme, line) entries to remove from the inverted index
+					std::vector<std::pair<uint, uint>> removed;
+
+					/// Pairs next to the new morphemes
+					hashset<quint64> touched;
+			};
+
+			/// Code length of each character
+			const QHash<QChar, real>& char_code_length;
+
+			/// Morphemes and their counts. Morpheme ids are the node ids
+			/// in the dictionary, which stay valid because counts are
+			/// only changed through set_count().
+			MorphemeDictionary morphemes;
+
+			/// Inverted index from morphemes to the lines containing them.
+			/// Entries may be stale and are checked when they are used.
+			hashmap<uint, std::vector<uint>> lines_of;
+
+			/// Counts of adjacent morpheme pairs (keyed by pair())
+			hashmap<quint64, uint> pairs;
+
+			/// Morpheme ids of all lines, back to back
+			std::vector<uint> tokens;
+
+			/// Offset of each line in tokens (one past the end for the last line)
+			std::vector<uint> offsets;
+
+			/// Lines which have been rewritten
+			hashmap<uint, std::vector<uint>> overlay;
+
+			/// Number of threads for applying operations
+			uint threads;
+
+			/// Number of operations applied
+			uint operations;
+
+			/// Number of rounds in the last run
+			uint rounds;
+
+			/// Whether the last run stopped because nothing could be improved
+			bool converged;
+
+			/// Dictionary cost
+			real dict_cost;
+
+			/// Sum of c * ln c over all morphemes
+			real count_cost;
+
+			/// Total morpheme count
+			uint total;
+
+			/// Pending operations
+			heap<Candidate> queue;
+
+			///
+			/// \brief Key for a pair of adjacent morphemes
+			/// \param _left
+			/// \param _right
+			/// \return
+			///
+			static inline quint64 pair(const uint _left,
+									   const uint _right)
+			{
+				return (static_cast<quint64>(_left) << 32) | _right;
+			}
+
+			/// The id of a morpheme, added if necessary
+			inline uint intern(const QStringView _morpheme)
+			{
+				return morphemes.insert(_morpheme);
+			}
+
+			/// The id of a morpheme (no_morpheme if it has not been seen)
+			inline uint find(const QStringView _morpheme) const
+			{
+				return morphemes.find(_morpheme);
+			}
+
+			/// The count of a morpheme (0 if it has not been seen)
+			inline uint count_of(const uint _id) const
+			{
+				return (_id == no_morpheme ? 0 : morphemes.count(_id));
+			}
+
+			/// The cost of spelling out a string
+			real code_length(const QStringView _str) const;
+
+			/// Update the count of a morpheme along with D, N and sum(c ln c)
+			void set_count(const uint _id,
+						   const uint _count);
+
+			/// The morpheme ids of a line
+			std::vector<uint> get_line(const uint _line) const;
+
+			/// Add or remove the pairs in a line
+			void count_pairs(const std::vector<uint>& _line,
+							 const int _sign);
+
+			///
+			/// \brief Gain of splitting a morpheme
+			/// \param _id
+			/// \param _word: the morpheme
+			/// \param _cost: the cost of spelling out the morpheme
+			/// \param _length: length of the left part
+			/// \return
+			///
+			real split_gain(const uint _id,
+							const QString& _word,
+							const real _cost,
+							const int _length) const;
+
+			///
+			/// \brief The best split of a morpheme
+			/// \param _id
+			/// \return A candidate with the length of the left part
+			/// (0 if the morpheme cannot be split)
+			///
+			Candidate best_split(const uint _id) const;
+
+			///
+			/// \brief Gain of merging adjacent occurrences of two morphemes
+			/// \param _left
+			/// \param _right
+			/// \param _count: the number of adjacent occurrences
+			/// \return
+			///
+			real merge_gain(const uint _left,
+							const uint _right,
+							const uint _count) const;
+
+			/// Number of non-overlapping occurrences of a morpheme followed by itself
+			uint count_repeats(const uint _id);
+
+			/// Recompute the gain of a candidate
+			real rescore(Candidate& _candidate);
+
+			/// Queue a candidate if it decreases the description length
+			inline void push(const Candidate& _candidate)
+			{
+				if (_candidate.gain > min_gain)
+				{
+					queue.push(_candidate);
+				}
+			}
+
+			/// Queue the best split of a morpheme
+			inline void push_split(const uint _id)
+			{
+				push(best_split(_id));
+			}
+
+			/// Queue a merge of two morphemes
+			void push_merge(const uint _left,
+							const uint _right);
+
+			/// Resolve the morphemes of a candidate, adding them if necessary
+			Operation resolve(const Candidate& _candidate);
+
+			///
+			/// \brief Apply an operation to a line
+			/// \param _op
+			/// \param _line
+			/// \param _rewrites: incremented for each occurrence rewritten
+			///
+			static void rewrite(const Operation& _op,
+								std::vector<uint>& _line,
+								uint& _rewrites);
+
+			///
+			/// \brief Apply a batch of operations which share no morphemes
+			/// \param _batch
+			/// \param _touched: pairs created by the operations
+			/// \param _dirty: morphemes whose counts changed
+			///
+			void apply(const std::vector<Operation>& _batch,
+					   hashset<quint64>& _touched,
+					   hashset<uint>& _dirty);
+
+			///
+			/// \brief Queue the splits of the morphemes which changed
+			/// and the merges of all pairs in the lines containing them
+			/// \param _dirty
+			///
+			void revisit(const hashset<uint>& _dirty);
+
+		public:
+
+			///
+			/// \param _char_code_length
+			/// \param _threads: number of threads (0 for all available cores)
+			///
+			Resegmenter(const QHash<QChar, real>& _char_code_length,
+						const uint _threads = 1)
+				:
+				  char_code_length(_char_code_length),
+				  threads(_threads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : _threads),
+				  operations(0),
+				  rounds(0),
+				  converged(false),
+				  dict_cost(0.0),
+				  count_cost(0.0),
+				  total(0)
+			{
+				clear();
+			}
+
+			///
+			/// \brief Remove the corpus and all morphemes
+			///
+			void clear();
+
+			///
+			/// \brief Add a line of the segmented corpus.
+			/// Only the morpheme ids of the line are stored.
+			/// \param _line: morphemes separated by spaces
+			///
+			void add_line(const QString& _line);
+
+			///
+			/// \brief Apply the best operations until no operation
+			/// decreases the description length or a budget runs out
+			/// \param _max_rounds: maximum number of rounds (0 for no limit)
+			/// \param _max_seconds: time limit (0 for no limit)
+			/// \param _progress: called every 1000 operations with the number
+			/// of operations so far and the current description length
+			/// \param _cancel: checked before each batch; the run stops
+			/// (leaving the corpus partly resegmented) when it is set
+			/// \return The number of operations applied
+			///
+			uint run(const uint _max_rounds = 0,
+					 const uint _max_seconds = 0,
+					 const std::function<void(const uint, const real)>& _progress = nullptr,
+					 const CancellationToken& _cancel = CancellationToken::none());
+
+			/// Number of lines in the corpus
+			inline uint get_line_count() const
+			{
+				return offsets.size() - 1;
+			}
+
+			///
+			/// \brief The current segmentation of a line
+			/// \param _line
+			/// \return Morphemes separated by spaces
+			///
+			QString get_segmentation(const uint _line) const;
+
+			///
+			/// \brief Replace the contents of a dictionary
+			/// with the current morpheme counts
+			/// \param _dictionary
+			///
+			void fill(MorphemeDictionary& _dictionary) const;
+
+			/// Number of rounds in the last run
+			inline uint get_rounds() const
+			{
+				return rounds;
+			}
+
+			/// Whether the last run stopped because nothing could be improved
+			inline bool is_converged() const
+			{
+				return converged;
+			}
+
+			/// Total morpheme count
+			inline uint get_total() const
+			{
+				return total;
+			}
+
+			/// Dictionary cost
+			inline real get_dict_cost() const
+			{
+				return dict_cost;
+			}
+
+			/// Corpus entropy (in nats per morpheme)
+			inline real get_entropy() const
+			{
+				return (total == 0 ? 0.0 : std::log(static_cast<real>(total)) - count_cost / total);
+			}
+
+			/// Description length of the dictionary and the corpus
+			inline real get_description_length() const
+			{
+				return dict_cost + Entropy::n_log_n(total) - count_cost;
+			}
+	};
+}
+
+#endif // RESEGMENTER_HPP
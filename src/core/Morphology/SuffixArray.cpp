@@ -1,20 +1,27 @@
 #include "SuffixArray.hpp"
+#include "LineReader.hpp"
 
 namespace Morpheus
 {
 
-	std::vector<uchar> SuffixArray::input_string;
-	SuffixArray::cmp SuffixArray::char_cmp;
+	constexpr uint SuffixArray::no_symbol;
 
-	void SuffixArray::set_filenames(const QString& _file_name)
+	bool SuffixArray::set_filenames(const QString& _file_name,
+									ProgressSink& _progress,
+									const CancellationToken& _cancel)
 	{
+		sink = &_progress;
+		cancel = &_cancel;
 		input_file.setFileName(_file_name);
 		QFileInfo fi(input_file);
 		QDir dir(fi.absoluteDir());
 		QString base(fi.baseName());
 		QString ext(fi.completeSuffix());
 		sa_file.setFileName(dir.absolutePath() + "/" + base + ".sa");
-		load_corpus();
+		const bool loaded(load_corpus());
+		sink = &ProgressSink::none();
+		cancel = &CancellationToken::none();
+		return loaded;
 	}
 
 	void SuffixArray::sort_suffixes(const std::vector<uint>&& _positions, const uint _depth)
@@ -37,33 +44,81 @@ namespace Morpheus
 		}
 	}
 
-	void SuffixArray::load_corpus()
+	bool SuffixArray::set_input(std::vector<uchar>&& _input,
+								ProgressSink& _progress,
+								const CancellationToken& _cancel)
+	{
+		sink = &_progress;
+		cancel = &_cancel;
+		input_string = std::move(_input);
+		input_string.push_back('\0');
+		const bool built(build());
+		sink = &ProgressSink::none();
+		cancel = &CancellationToken::none();
+		return built;
+	}
+
+	bool SuffixArray::load_corpus()
 	{
 		input_string.clear();
-		SA.clear();
-		suffixes_to_sort.clear();
-		char_counts.clear();
 
-		std::ifstream input_stream;
-		input_stream.open(input_file.fileName().toUtf8().constData());
-		if (input_stream.is_open())
+		LineReader input;
+		QString error;
+		if (input.open(input_file.fileName(), error))
 		{
-			char ch;
-			while (input_stream.get(ch))
-			{
-				input_string.push_back(static_cast<uchar>(ch));
-			}
-			input_stream.close();
+			input_string.reserve(input.size() + 1);
+			input_string.assign(input.data(), input.data() + input.size());
 		}
 		input_string.push_back('\0');
 
+		return build();
+	}
+
+	bool SuffixArray::build()
+	{
+		SA.clear();
+		suffixes_to_sort.clear();
+		char_counts.clear();
+
 		if (input_string.size() > 0)
 		{
+			make_symbol_table();
 			make_index(input_string, char_index);
+
+			/// Each step returns early if it is cancelled
 			put_chars_in_buckets(input_string, char_counts, true);
+			if (cancel->is_cancelled())
+			{
+				return false;
+			}
+
 			sort(input_string.size() - 1, true);
+			if (cancel->is_cancelled())
+			{
+				return false;
+			}
+
 			compile_suffix_array(SA, char_counts, true);
 		}
+		return !cancel->is_cancelled();
+	}
+
+	void SuffixArray::make_symbol_table()
+	{
+		symbol_ids.assign(std::numeric_limits<ushort>::max() + 1, no_symbol);
+		symbol_count = 0;
+
+		for (uint pos = 0; pos < input_string.size() - 1; ++pos)
+		{
+			if ((input_string[pos] & 0xC0) != 0x80)
+			{
+				uint& id(symbol_ids[decode_utf8(pos).unicode()]);
+				if (id == no_symbol)
+				{
+					id = symbol_count++;
+				}
+			}
+		}
 	}
 
 	std::vector<uchar> SuffixArray::str_to_vec(const QString& _str)
@@ -117,21 +172,10 @@ namespace Morpheus
 										   hashmap<uchar,uint>& _char_counts,
 										   const bool _progress)
 	{
-		/// Progress bar
-		QProgressDialog pd;
-
 		if (_progress)
 		{
-			pd.setLabelText("Identifying and bucketing suffixes...");
-			pd.setMinimum(0);
-			pd.setMaximum(0);
-			pd.setValue(0);
-			pd.setAutoClose(true);
-			pd.setWindowModality(Qt::WindowModal);
-			pd.setCancelButton(0);
-			pd.open();
 			progress = 0;
-			QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+			sink->begin("Identifying and bucketing suffixes...");
 		}
 
 		//////////////////////////////////////////////////
@@ -149,6 +193,12 @@ namespace Morpheus
 			l_count	= 0;
 			while (char_count <= _input.size() - 2)
 			{
+				if ((char_count & 0xFFFFF) == 0
+					&& cancel->is_cancelled())
+				{
+					return;
+				}
+
 				if (_input[char_count] < _input[char_count + 1])
 				{
 					/// This is an S-type suffix
@@ -192,6 +242,12 @@ namespace Morpheus
 			char_count = 0;
 			while (char_count <= _input.size() - 2)
 			{
+				if ((char_count & 0xFFFFF) == 0
+					&& cancel->is_cancelled())
+				{
+					return;
+				}
+
 				ch = _input[char_count];
 
 				if ((ch < _input[char_count + 1] && s_count <= l_count) ||
@@ -238,31 +294,24 @@ namespace Morpheus
 		/// Sort the smaller collection of suffixes
 		///////////////////////////////////////////
 
-		/// Progress bar
-		QProgressDialog pd;
-
 		if (_progress)
 		{
-			pd.setLabelText("Sorting suffixes...");
-			pd.setMinimum(0);
-			pd.setMaximum(suffixes_to_sort.size());
-			pd.setValue(0);
-			pd.setAutoClose(true);
-			pd.setWindowModality(Qt::WindowModal);
-			pd.setCancelButton(0);
-			pd.open();
 			progress = 0;
-			QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+			sink->begin("Sorting suffixes...", suffixes_to_sort.size());
 		}
 
 		sorted_suffixes.clear();
 		for (const std::pair<uchar, std::vector<uint>>& ch : suffixes_to_sort)
 		{
+			if (cancel->is_cancelled())
+			{
+				return;
+			}
+
 			sort_suffixes(std::move(ch.second), 1);
 			if (_progress)
 			{
-				pd.setValue(++progress);
-				QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+				sink->update("Sorting suffixes...", ++progress, suffixes_to_sort.size());
 			}
 		}
 		suffixes_to_sort.clear();
@@ -273,21 +322,10 @@ namespace Morpheus
 										   const hashmap<uchar, uint>& _char_counts,
 										   const bool _progress)
 	{
-		/// Progress bar
-		QProgressDialog pd;
-
 		if (_progress)
 		{
-			pd.setLabelText("Populating sorted suffixes...");
-			pd.setMinimum(0);
-			pd.setMaximum(sorted_suffixes.size());
-			pd.setValue(0);
-			pd.setAutoClose(true);
-			pd.setWindowModality(Qt::WindowModal);
-			pd.setCancelButton(0);
-			pd.open();
 			progress = 0;
-			QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+			sink->begin("Populating sorted suffixes...", sorted_suffixes.size());
 		}
 
 		////////////////////////////
@@ -311,6 +349,11 @@ namespace Morpheus
 			/// S-type suffixes go at the end of their bucket.
 			for (const std::pair<uchar, std::vector<uint>>& ch : sorted_suffixes)
 			{
+				if (cancel->is_cancelled())
+				{
+					return;
+				}
+
 				std::vector<uint>::const_reverse_iterator pos = ch.second.rbegin();
 				while (pos != ch.second.rend())
 				{
@@ -320,8 +363,7 @@ namespace Morpheus
 				}
 				if (_progress)
 				{
-					pd.setValue(++progress);
-					QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+					sink->update("Populating sorted suffixes...", ++progress, sorted_suffixes.size());
 				}
 			}
 		}
@@ -331,6 +373,11 @@ namespace Morpheus
 			/// L-type suffixes go at the front of their bucket.
 			for (const std::pair<uchar, std::vector<uint>>& ch : sorted_suffixes)
 			{
+				if (cancel->is_cancelled())
+				{
+					return;
+				}
+
 				std::vector<uint>::const_iterator pos = ch.second.begin();
 				while (pos != ch.second.end())
 				{
@@ -340,8 +387,7 @@ namespace Morpheus
 				}
 				if (_progress)
 				{
-					pd.setValue(++progress);
-					QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+					sink->update("Populating sorted suffixes...", ++progress, sorted_suffixes.size());
 				}
 			}
 		}
@@ -351,10 +397,8 @@ namespace Morpheus
 
 		if (_progress)
 		{
-			pd.setLabelText("Filling gaps...");
-			pd.setMaximum(SA.size());
-			pd.setValue(progress = 0);
-			QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+			progress = 0;
+			sink->begin("Filling gaps...", _SA.size());
 		}
 		/// Scan all the suffixes and populate the empty slots in each bucket
 		if (s_count <= l_count)
@@ -363,6 +407,11 @@ namespace Morpheus
 			std::map<uchar, std::vector<uint>>::const_iterator map_it = _SA.begin();
 			while (map_it != _SA.end())
 			{
+				if (cancel->is_cancelled())
+				{
+					return;
+				}
+
 				std::vector<uint>::const_iterator vec_it = map_it->second.begin();
 				while (vec_it != map_it->second.end())
 				{
@@ -377,8 +426,7 @@ namespace Morpheus
 				++map_it;
 				if (_progress)
 				{
-					pd.setValue(++progress);
-					QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+					sink->update("Filling gaps...", ++progress, _SA.size());
 				}
 			}
 		}
@@ -388,6 +436,11 @@ namespace Morpheus
 			std::map<uchar, std::vector<uint>>::const_reverse_iterator map_rit = _SA.rbegin();
 			while (map_rit != _SA.rend())
 			{
+				if (cancel->is_cancelled())
+				{
+					return;
+				}
+
 				std::vector<uint>::const_reverse_iterator vec_rit = map_rit->second.rbegin();
 				while (vec_rit != map_rit->second.rend())
 				{
@@ -402,8 +455,7 @@ namespace Morpheus
 				++map_rit;
 				if (_progress)
 				{
-					pd.setValue(++progress);
-					QApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+					sink->update("Filling gaps...", ++progress, _SA.size());
 				}
 			}
 		}
@@ -423,8 +475,7 @@ namespace Morpheus
 
 				for (uint i = 1; i < _key.size(); ++i)
 				{
-					char_cmp.depth = i;
-					range = std::equal_range(range.first, range.second, _key[i], SuffixArray::char_cmp);
+					range = std::equal_range(range.first, range.second, _key[i], cmp{input_string, i});
 					if (std::distance(range.first,range.second) <= 0)
 					{
 						break;
@@ -437,72 +488,292 @@ namespace Morpheus
 
 	SuffixArray::vrange SuffixArray::get_equal_range(std::map<uchar, std::vector<uint> >& _SA, const QString& _qstr)
 	{
-		std::string key_str(_qstr.toStdString());
-		std::vector<uchar> key;
-		key.reserve(key_str.size());
+		Cursor cursor(get_cursor(_qstr));
+		if (cursor.size() > 0)
+		{
+			return vrange(cursor.first, cursor.second);
+		}
+		return vrange();
+	}
+
+	SuffixArray::Cursor SuffixArray::get_cursor(const QStringView _qstr) const
+	{
+		Cursor cursor;
+		for (const QChar ch : _qstr)
+		{
+			extend(cursor, ch);
+		}
+		return cursor;
+	}
+
+	void SuffixArray::encode(const QStringView _qstr,
+							 std::vector<uchar>& _bytes,
+							 std::vector<uint>& _offsets)
+	{
+		_bytes.clear();
+		_offsets.clear();
+		_bytes.reserve(3 * _qstr.size());
+		_offsets.reserve(_qstr.size() + 1);
 
-		if (key_str.size() > 0)
+		for (int i = 0; i < _qstr.size(); ++i)
 		{
-			for (const char ch : key_str)
+			_offsets.push_back(_bytes.size());
+
+			uint code_point(_qstr.at(i).unicode());
+			if (_qstr.at(i).isHighSurrogate()
+				&& i + 1 < _qstr.size()
+				&& _qstr.at(i + 1).isLowSurrogate())
+			{
+				/// Encoded together with the low surrogate
+				continue;
+			}
+			else if (_qstr.at(i).isLowSurrogate()
+					 && i > 0
+					 && _qstr.at(i - 1).isHighSurrogate())
+			{
+				code_point = QChar::surrogateToUcs4(_qstr.at(i - 1), _qstr.at(i));
+			}
+
+			if (code_point < 0x80)
+			{
+				_bytes.push_back(static_cast<uchar>(code_point));
+			}
+			else if (code_point < 0x800)
+			{
+				_bytes.push_back(static_cast<uchar>(0xC0 | (code_point >> 6)));
+				_bytes.push_back(static_cast<uchar>(0x80 | (code_point & 0x3F)));
+			}
+			else if (code_point < 0x10000)
+			{
+				_bytes.push_back(static_cast<uchar>(0xE0 | (code_point >> 12)));
+				_bytes.push_back(static_cast<uchar>(0x80 | ((code_point >> 6) & 0x3F)));
+				_bytes.push_back(static_cast<uchar>(0x80 | (code_point & 0x3F)));
+			}
+			else
 			{
-				key.push_back(static_cast<uchar>(ch));
+				_bytes.push_back(static_cast<uchar>(0xF0 | (code_point >> 18)));
+				_bytes.push_back(static_cast<uchar>(0x80 | ((code_point >> 12) & 0x3F)));
+				_bytes.push_back(static_cast<uchar>(0x80 | ((code_point >> 6) & 0x3F)));
+				_bytes.push_back(static_cast<uchar>(0x80 | (code_point & 0x3F)));
 			}
-			return get_equal_range(_SA,key);
 		}
-		return vrange();
+		_offsets.push_back(_bytes.size());
+	}
+
+	void SuffixArray::extend(Cursor& _cursor, const uchar _byte) const
+	{
+		if (!_cursor.valid)
+		{
+			return;
+		}
+
+		if (_cursor.depth == 0)
+		{
+			/// The first byte selects the bucket
+			std::map<uchar, std::vector<uint>>::const_iterator bucket(SA.find(_byte));
+			if (bucket == SA.end())
+			{
+				_cursor.valid = false;
+			}
+			else
+			{
+				_cursor.first = bucket->second.cbegin();
+				_cursor.second = bucket->second.cend();
+			}
+		}
+		else
+		{
+			/// Binary search within the current interval only.
+			/// The comparator is local so that cursors can be
+			/// extended from several threads at once.
+			vrange range(std::equal_range(_cursor.first, _cursor.second, _byte, cmp{input_string, _cursor.depth}));
+			_cursor.first = range.first;
+			_cursor.second = range.second;
+			if (_cursor.first == _cursor.second)
+			{
+				_cursor.valid = false;
+			}
+		}
+		++_cursor.depth;
+	}
+
+	void SuffixArray::extend(Cursor& _cursor, const QChar _ch) const
+	{
+		uint code_point(_ch.unicode());
+
+		if (_ch.isHighSurrogate())
+		{
+			/// Wait for the low surrogate before narrowing the interval
+			_cursor.pending = _ch;
+			return;
+		}
+		else if (_ch.isLowSurrogate()
+				 && _cursor.pending.isHighSurrogate())
+		{
+			code_point = QChar::surrogateToUcs4(_cursor.pending, _ch);
+		}
+		_cursor.pending = QChar();
+
+		/// Encode the character as UTF-8, which is
+		/// how the input string is stored
+		if (code_point < 0x80)
+		{
+			extend(_cursor, static_cast<uchar>(code_point));
+		}
+		else if (code_point < 0x800)
+		{
+			extend(_cursor, static_cast<uchar>(0xC0 | (code_point >> 6)));
+			extend(_cursor, static_cast<uchar>(0x80 | (code_point & 0x3F)));
+		}
+		else if (code_point < 0x10000)
+		{
+			extend(_cursor, static_cast<uchar>(0xE0 | (code_point >> 12)));
+			extend(_cursor, static_cast<uchar>(0x80 | ((code_point >> 6) & 0x3F)));
+			extend(_cursor, static_cast<uchar>(0x80 | (code_point & 0x3F)));
+		}
+		else
+		{
+			extend(_cursor, static_cast<uchar>(0xF0 | (code_point >> 18)));
+			extend(_cursor, static_cast<uchar>(0x80 | ((code_point >> 12) & 0x3F)));
+			extend(_cursor, static_cast<uchar>(0x80 | ((code_point >> 6) & 0x3F)));
+			extend(_cursor, static_cast<uchar>(0x80 | (code_point & 0x3F)));
+		}
 	}
 
 	QHash<QChar, uint> SuffixArray::get_predecessors(const QString& _key)
+	{
+		return get_predecessors(get_cursor(_key));
+	}
+
+	QHash<QChar, uint> SuffixArray::get_predecessors(const Cursor& _cursor)
 	{
 		predecessors.clear();
-		std::string utf8_str;
-		vrange range(get_equal_range(SA, std::move(_key)));
+		if (_cursor.size() == 0)
+		{
+			return predecessors;
+		}
+
+		vrange range(_cursor.first, _cursor.second);
 		while (range.first != range.second)
 		{
 			uint offset(*range.first);
 			if (offset > 0)
 			{
-				utf8_str.clear();
-				utf8_str.push_back(static_cast<char>(input_string[--offset]));
-				if (input_string[offset] > 0x7F)
+				/// Step back to the lead byte of the preceding character
+				--offset;
+				while (offset > 0
+					   && (input_string[offset] & 0xC0) == 0x80)
 				{
-					do
-					{
-						utf8_str.push_back(static_cast<char>(input_string[--offset]));
-					} while (input_string[offset] < 0xC0 &&
-							 offset > 0);
-					std::reverse(utf8_str.begin(),utf8_str.end());
+					--offset;
 				}
-				++predecessors[QString::fromStdString(utf8_str).at(0)];
+				++predecessors[decode_utf8(offset)];
 			}
 			++range.first;
 		}
 		return predecessors;
 	}
 
+	uint SuffixArray::count_predecessors(const Cursor& _cursor, Counts& _counts) const
+	{
+		/// Only reset the counts used by the previous query
+		for (const uint id : _counts.ids)
+		{
+			_counts.by_id[id] = 0;
+		}
+		_counts.by_id.resize(symbol_count, 0);
+		_counts.ids.clear();
+		_counts.values.clear();
+		_counts.total = 0;
+
+		if (_cursor.size() == 0)
+		{
+			return 0;
+		}
+
+		for (vcit it = _cursor.first; it != _cursor.second; ++it)
+		{
+			uint offset(*it);
+			if (offset > 0)
+			{
+				--offset;
+				while (offset > 0
+					   && (input_string[offset] & 0xC0) == 0x80)
+				{
+					--offset;
+				}
+				uint id(symbol_ids[decode_utf8(offset).unicode()]);
+				if (_counts.by_id[id]++ == 0)
+				{
+					_counts.ids.push_back(id);
+				}
+				++_counts.total;
+			}
+		}
+
+		for (const uint id : _counts.ids)
+		{
+			_counts.values.push_back(_counts.by_id[id]);
+		}
+		return _counts.ids.size();
+	}
+
+	uint SuffixArray::count_successors(const Cursor& _cursor, Counts& _counts) const
+	{
+		for (const uint id : _counts.ids)
+		{
+			_counts.by_id[id] = 0;
+		}
+		_counts.by_id.resize(symbol_count, 0);
+		_counts.ids.clear();
+		_counts.values.clear();
+		_counts.total = 0;
+
+		if (_cursor.size() == 0)
+		{
+			return 0;
+		}
+
+		for (vcit it = _cursor.first; it != _cursor.second; ++it)
+		{
+			uint offset(*it + _cursor.depth);
+			if (input_string.size() - 1 > offset)
+			{
+				uint id(symbol_ids[decode_utf8(offset).unicode()]);
+				if (_counts.by_id[id]++ == 0)
+				{
+					_counts.ids.push_back(id);
+				}
+				++_counts.total;
+			}
+		}
+
+		for (const uint id : _counts.ids)
+		{
+			_counts.values.push_back(_counts.by_id[id]);
+		}
+		return _counts.ids.size();
+	}
+
 	QHash<QChar, uint> SuffixArray::get_successors(const QString& _key)
+	{
+		return get_successors(get_cursor(_key));
+	}
+
+	QHash<QChar, uint> SuffixArray::get_successors(const Cursor& _cursor)
 	{
 		successors.clear();
-		uint key_length(_key.toStdString().size());
-		std::string utf8_str;
-		vrange range(get_equal_range(SA, std::move(_key)));
+		if (_cursor.size() == 0)
+		{
+			return successors;
+		}
+
+		vrange range(_cursor.first, _cursor.second);
 		while (range.first != range.second)
 		{
-			uint offset(*range.first + key_length);
+			uint offset(*range.first + _cursor.depth);
 			if (input_string.size() - 1 > offset)
 			{
-				utf8_str.clear();
-				utf8_str.push_back(static_cast<char>(input_string[offset]));
-				if (input_string[offset] > 0x7F)
-				{
-					do
-					{
-						utf8_str.push_back(static_cast<char>(input_string[++offset]));
-					} while (input_string[offset] < 0xC0 &&
-							 input_string[offset] > 0x7F &&
-							 offset < input_string.size() - 1);
-				}
-				++successors[QString::fromStdString(utf8_str).at(0)];
+				++successors[decode_utf8(offset)];
 			}
 			++range.first;
 		}
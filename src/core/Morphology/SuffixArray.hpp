@@ -2,6 +2,8 @@
 #define SUFFIXARRAY_HPP
 
 #include "Globals.hpp"
+#include "ProgressSink.hpp"
+#include "CancellationToken.hpp"
 
 namespace Morpheus
 {
@@ -25,11 +27,19 @@ namespace Morpheus
 			/// A generic progress value
 			uint progress;
 
+			/// Receives progress reports while the suffix array is built
+			ProgressSink* sink;
+
+			/// Stops the construction of the suffix array
+			const CancellationToken* cancel;
+
 			QFile input_file;
 			QFile sa_file;
 
 			/// The input file as a continuous string
-			static std::vector<uchar> input_string;
+			/// (owned by each instance, so a new suffix array can be
+			/// built while the previous one is still in use)
+			std::vector<uchar> input_string;
 
 			/// Array holding conversion indices
 			/// from the suffix array to the original string
@@ -60,39 +70,61 @@ namespace Morpheus
 			QHash<QChar, uint> predecessors;
 			QHash<QChar, uint> successors;
 
+			/// Dense id of each UTF-16 code unit occurring in the input
+			/// (no_symbol for those which do not occur)
+			std::vector<uint> symbol_ids;
+
+			/// The number of distinct symbols in the input
+			uint symbol_count;
+
+			/// Assign dense ids to the characters in the input string
+			void make_symbol_table();
+
 			/// map<pattern length, map<# of occurrences, string>>
 			QHash<QString, uint> pattern_occurrences;
 
-			static struct cmp
+			/// Compares the character at a given depth of a suffix with a key character
+			struct cmp
 			{
+					const std::vector<uchar>& input;
 					uint depth;
 
 					bool operator()(const uint _pos,
-									const uchar _key_ch)
+									const uchar _key_ch) const
 					{
-						if (_pos + depth < input_string.size())
+						if (_pos + depth < input.size())
 						{
-							return input_string[_pos + depth] < _key_ch;
+							return input[_pos + depth] < _key_ch;
 						}
 						return true;
 					}
 
 					bool operator()(const uchar _key_ch,
-									const uint _pos)
+									const uint _pos) const
 					{
-						if (_pos + depth < input_string.size())
+						if (_pos + depth < input.size())
 						{
-							return _key_ch < input_string[_pos + depth];
+							return _key_ch < input[_pos + depth];
 						}
 						return false;
 					}
-
-			} char_cmp;
+			};
 
 			void sort_suffixes(const std::vector<uint>&& _positions,
 							   const uint _depth);
 
-			void load_corpus();
+			///
+			/// \brief Read the input file and build the suffix array
+			/// \return Whether the suffix array was built (false if cancelled)
+			///
+			bool load_corpus();
+
+			///
+			/// \brief Build the suffix array over input_string
+			/// (which ends with \0)
+			/// \return Whether the suffix array was built (false if cancelled)
+			///
+			bool build();
 
 			std::vector<uchar> str_to_vec(const QString& _str);
 
@@ -120,12 +152,261 @@ namespace Morpheus
 			vrange get_equal_range(std::map<uchar,std::vector<uint>>& _SA,
 								   const QString& _qstr);
 
+			///
+			/// \brief Decode the UTF-8 sequence starting at _pos in the input string
+			/// \param _pos
+			/// \return The character (the high surrogate for characters outside the BMP)
+			///
+			inline QChar decode_utf8(uint _pos) const
+			{
+				uint code_point(input_string[_pos]);
+				uint trailing(0);
+				if (code_point >= 0xF0)
+				{
+					code_point &= 0x07;
+					trailing = 3;
+				}
+				else if (code_point >= 0xE0)
+				{
+					code_point &= 0x0F;
+					trailing = 2;
+				}
+				else if (code_point >= 0xC0)
+				{
+					code_point &= 0x1F;
+					trailing = 1;
+				}
+
+				while (trailing-- > 0
+					   && ++_pos < input_string.size()
+					   && (input_string[_pos] & 0xC0) == 0x80)
+				{
+					code_point = (code_point << 6) | (input_string[_pos] & 0x3F);
+				}
+
+				if (QChar::requiresSurrogates(code_point))
+				{
+					return QChar(QChar::highSurrogate(code_point));
+				}
+				return QChar(code_point);
+			}
+
 		public:
 
-			SuffixArray(){}
+			///
+			/// \brief A cursor holding the interval of suffixes which
+			/// start with the current search string and the depth
+			/// (in bytes) of that string. Extending the cursor by one
+			/// character narrows the existing interval instead of
+			/// searching again from the first byte.
+			///
+			struct Cursor
+			{
+					/// Interval of matching suffixes
+					vcit first;
+					vcit second;
+
+					/// Length of the search string in bytes
+					uint depth = 0;
+
+					/// False once the search string has no occurrences
+					bool valid = true;
+
+					/// A high surrogate waiting for its low counterpart
+					QChar pending;
+
+					/// Number of suffixes in the interval
+					inline uint size() const
+					{
+						if (!valid
+							|| depth == 0)
+						{
+							return 0;
+						}
+						return static_cast<uint>(std::distance(first, second));
+					}
+
+					///
+					/// \brief Identifies a string by its interval and depth.
+					/// Strings with the same key have the same occurrences,
+					/// so statistics can be cached by key without
+					/// building the string itself.
+					///
+					struct Key
+					{
+							const uint* first;
+							uint size;
+							uint depth;
+
+							/// Optional context character
+							ushort context;
+
+							inline bool operator==(const Key& _other) const
+							{
+								return first == _other.first
+										&& size == _other.size
+										&& depth == _other.depth
+										&& context == _other.context;
+							}
+					};
+
+					struct KeyHash
+					{
+							inline std::size_t operator()(const Key& _key) const
+							{
+								std::size_t seed(std::hash<const uint*>()(_key.first));
+								seed ^= _key.size + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+								seed ^= _key.depth + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+								seed ^= _key.context + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+								return seed;
+							}
+					};
+
+					/// The cache key for this cursor
+					inline Key key(const QChar _context = QChar()) const
+					{
+						uint sz(size());
+						return Key{(sz > 0 ? &*first : nullptr), sz, depth, _context.unicode()};
+					}
+			};
+
+			/// Marks characters which do not occur in the input
+			static constexpr uint no_symbol = std::numeric_limits<uint>::max();
+
+			///
+			/// \brief Dense counts of the predecessors or successors of a string,
+			/// indexed by symbol id. The buffers are reused between queries.
+			///
+			struct Counts
+			{
+					/// Count for each symbol id
+					std::vector<uint> by_id;
+
+					/// Ids with a nonzero count
+					std::vector<uint> ids;
+
+					/// Nonzero counts, in the same order as the ids
+					std::vector<uint> values;
+
+					/// Sum of all counts
+					uint total = 0;
+
+					/// The count for a symbol id
+					inline uint get(const uint _id) const
+					{
+						return (_id < by_id.size() ? by_id[_id] : 0);
+					}
+			};
+
+			/// A hashmap keyed by suffix array interval
+			template <typename T>
+			using interval_map = std::unordered_map<Cursor::Key, T, Cursor::KeyHash>;
+
+			SuffixArray()
+				:
+				  sink(&ProgressSink::none()),
+				  cancel(&CancellationToken::none())
+			{}
 
 			~SuffixArray(){}
 
+			///
+			/// \brief Return a cursor for the empty string
+			/// \return
+			///
+			inline Cursor get_cursor() const
+			{
+				return Cursor();
+			}
+
+			///
+			/// \brief Return a cursor for a string
+			/// \param _qstr: a view of the string
+			/// \return
+			///
+			Cursor get_cursor(const QStringView _qstr) const;
+
+			///
+			/// \brief Return a cursor for a string which is already
+			/// encoded as UTF-8 (see encode()).
+			/// \param _begin
+			/// \param _end
+			/// \return
+			///
+			inline Cursor get_cursor(const uchar* _begin,
+									 const uchar* _end) const
+			{
+				Cursor cursor;
+				extend(cursor, _begin, _end);
+				return cursor;
+			}
+
+			///
+			/// \brief Narrow the interval of a cursor by a single byte
+			/// \param _cursor
+			/// \param _byte
+			///
+			void extend(Cursor& _cursor,
+						const uchar _byte) const;
+
+			///
+			/// \brief Narrow the interval of a cursor by a single character
+			/// \param _cursor
+			/// \param _ch
+			///
+			void extend(Cursor& _cursor,
+						const QChar _ch) const;
+
+			///
+			/// \brief Narrow the interval of a cursor by a UTF-8 encoded span
+			/// \param _cursor
+			/// \param _begin
+			/// \param _end
+			///
+			inline void extend(Cursor& _cursor,
+							   const uchar* _begin,
+							   const uchar* _end) const
+			{
+				while (_begin != _end
+					   && _cursor.valid)
+				{
+					extend(_cursor, *_begin++);
+				}
+			}
+
+			///
+			/// \brief Encode a string as UTF-8, the representation used by the index.
+			/// _offsets[i] holds the offset of the first byte of the i-th
+			/// character (with one extra entry for the end of the string).
+			/// A high surrogate takes up no bytes and its low surrogate
+			/// takes up all four, so spans never split a character.
+			/// \param _qstr
+			/// \param _bytes
+			/// \param _offsets
+			///
+			static void encode(const QStringView _qstr,
+							   std::vector<uchar>& _bytes,
+							   std::vector<uint>& _offsets);
+
+			///
+			/// \brief Return a copy of the cursor extended by a single character
+			/// \param _cursor
+			/// \param _ch
+			/// \return
+			///
+			inline Cursor extended(Cursor _cursor,
+								   const QChar _ch) const
+			{
+				extend(_cursor, _ch);
+				return _cursor;
+			}
+
+			/// Get the total number of occurrences of the string at the cursor
+			inline uint get_occurrences(const Cursor& _cursor) const
+			{
+				return _cursor.size();
+			}
+
 			/// Get the total number of occurrences of a string
 			inline uint get_occurrences(const QString& _qstr)
 			{
@@ -165,6 +446,23 @@ namespace Morpheus
 				return total;
 			}
 
+			/// Count the total number of predecessors of the string at the cursor
+			inline uint get_total_predecessor_count(const Cursor& _cursor) const
+			{
+				uint total(0);
+				if (_cursor.size() > 0)
+				{
+					for (vcit it = _cursor.first; it != _cursor.second; ++it)
+					{
+						if (*it > 0)
+						{
+							++total;
+						}
+					}
+				}
+				return total;
+			}
+
 			/// Count the total number of successors (as Unicode characters, not as chars)
 			inline uint get_total_successor_count(const QString& _key)
 			{
@@ -181,22 +479,79 @@ namespace Morpheus
 				return total;
 			}
 
+			/// Count the total number of successors of the string at the cursor
+			inline uint get_total_successor_count(const Cursor& _cursor) const
+			{
+				uint total(0);
+				if (_cursor.size() > 0)
+				{
+					for (vcit it = _cursor.first; it != _cursor.second; ++it)
+					{
+						if (input_string.size() - 1 > *it + _cursor.depth)
+						{
+							++total;
+						}
+					}
+				}
+				return total;
+			}
+
 			/// Count the number of distinct predecessors (as Unicode characters, not as chars)
 			inline uint get_distinct_predecessor_count(const QString& _key)
 			{
 				return get_predecessors(std::move(_key)).size();
 			}
 
+			/// Count the number of distinct predecessors of the string at the cursor
+			inline uint get_distinct_predecessor_count(const Cursor& _cursor)
+			{
+				return get_predecessors(_cursor).size();
+			}
+
 			/// Count the number of distinct successors (as Unicode characters, not as chars)
 			inline uint get_distinct_successor_count(const QString& _key)
 			{
 				return get_successors(std::move(_key)).size();
 			}
 
+			/// Count the number of distinct successors of the string at the cursor
+			inline uint get_distinct_successor_count(const Cursor& _cursor)
+			{
+				return get_successors(_cursor).size();
+			}
+
+			/// Return the dense id of a character (no_symbol if it does not occur in the input)
+			inline uint get_symbol_id(const QChar _ch) const
+			{
+				return symbol_ids.empty() ? no_symbol : symbol_ids[_ch.unicode()];
+			}
+
+			///
+			/// \brief Count the predecessors of the string at the cursor by symbol id
+			/// \param _cursor
+			/// \param _counts
+			/// \return The number of distinct predecessors
+			///
+			uint count_predecessors(const Cursor& _cursor,
+									Counts& _counts) const;
+
+			///
+			/// \brief Count the successors of the string at the cursor by symbol id
+			/// \param _cursor
+			/// \param _counts
+			/// \return The number of distinct successors
+			///
+			uint count_successors(const Cursor& _cursor,
+								  Counts& _counts) const;
+
 			QHash<QChar, uint> get_predecessors(const QString& _key);
 
+			QHash<QChar, uint> get_predecessors(const Cursor& _cursor);
+
 			QHash<QChar, uint> get_successors(const QString& _key);
 
+			QHash<QChar, uint> get_successors(const Cursor& _cursor);
+
 			hashset<uchar> get_successors(const std::vector<uchar>& _key);
 
 			hashset<uchar> get_successors(vrange& _range,
@@ -209,7 +564,27 @@ namespace Morpheus
 
 		public slots:
 
-			void set_filenames(const QString& _file_name);
+			///
+			/// \brief Load the corpus and build the suffix array
+			/// \param _file_name
+			/// \param _progress: receives progress reports while the suffix array is built
+			/// \param _cancel: checked between the steps of the construction
+			/// \return Whether the suffix array was built (false if cancelled)
+			///
+			bool set_filenames(const QString& _file_name,
+							   ProgressSink& _progress = ProgressSink::none(),
+							   const CancellationToken& _cancel = CancellationToken::none());
+
+			///
+			/// \brief Build the suffix array over a corpus which is already in memory
+			/// \param _input: the UTF-8 bytes of the corpus (without the terminating \0)
+			/// \param _progress: receives progress reports while the suffix array is built
+			/// \param _cancel: checked between the steps of the construction
+			/// \return Whether the suffix array was built (false if cancelled)
+			///
+			bool set_input(std::vector<uchar>&& _input,
+						   ProgressSink& _progress = ProgressSink::none(),
+						   const CancellationToken& _cancel = CancellationToken::none());
 
 		signals:
 
@@ -0,0 +1,248 @@
+#ifndef VITERBISEGMENTER_HPP
+#define VITERBISEGMENTER_HPP
+
+#include "Globals.hpp"
+#include "MorphemeDictionary.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief Morpheme costs for Viterbi segmentation taken from a dictionary.
+	///
+	/// A morpheme with count c costs -ln(c / N) (N = the total count).
+	/// A character which is not covered by any morpheme is treated as a
+	/// new morpheme seen once, i.e., it costs ln N plus its code length.
+	///
+	class DictionaryCosts
+	{
+		private:
+
+			const MorphemeDictionary& dictionary;
+
+			const QHash<QChar, real>& char_code_length;
+
+			/// ln N
+			real log_total;
+
+			/// Code length of characters outside the alphabet
+			real unknown_char_cost;
+
+		public:
+
+			static constexpr uint no_node = MorphemeDictionary::no_node;
+
+			///
+			/// \param _dictionary
+			/// \param _char_code_length
+			///
+			DictionaryCosts(const MorphemeDictionary& _dictionary,
+							const QHash<QChar, real>& _char_code_length)
+				:
+				  dictionary(_dictionary),
+				  char_code_length(_char_code_length),
+				  log_total(std::log(static_cast<real>(std::max(_dictionary.get_total(), 1u)))),
+				  unknown_char_cost(0.0)
+			{
+				for (const real length : _char_code_length)
+				{
+					unknown_char_cost = std::max(unknown_char_cost, length);
+				}
+			}
+
+			inline uint root() const
+			{
+				return MorphemeDictionary::root;
+			}
+
+			inline uint step(const uint _node,
+							 const QChar _ch) const
+			{
+				return dictionary.step(_node, _ch);
+			}
+
+			/// Cost of the morpheme ending at a node (infinite if there is none)
+			inline real cost(const uint _node) const
+			{
+				const uint count(dictionary.count(_node));
+				return (count == 0 ? std::numeric_limits<real>::infinity() : log_total - std::log(static_cast<real>(count)));
+			}
+
+			/// Cost of a character which is not covered by any morpheme
+			inline real unknown_cost(const QStringView _ch) const
+			{
+				real length(log_total);
+				for (const QChar ch : _ch)
+				{
+					length += char_code_length.value(ch, unknown_char_cost);
+				}
+				return length;
+			}
+	};
+
+	///
+	/// \brief Segmentation by dynamic programming (Viterbi) over all
+	/// morphemes which occur in a word.
+	///
+	/// The segmentation of a word is the sequence of morphemes with the
+	/// lowest total cost. Morphemes are found by walking a trie from each
+	/// position, so a word of length n takes O(n * m) steps, where m is the
+	/// length of the longest morpheme. Characters not covered by any
+	/// morpheme are kept as morphemes on their own (surrogate pairs are
+	/// not split). No suffix array is involved, so this works equally well
+	/// for resegmenting the corpus and for segmenting new text.
+	///
+	/// The model provides the trie and the costs:
+	/// root(), step(node, ch) (returning Model::no_node at a dead end),
+	/// cost(node) (infinite where no morpheme ends) and unknown_cost(ch).
+	///
+	template <typename Model>
+	class ViterbiSegmenter
+	{
+		private:
+
+			const Model& model;
+
+			/// Lowest cost of each prefix of the word
+			std::vector<real> best;
+
+			/// Start of the last morpheme in the best segmentation of each prefix
+			std::vector<int> back;
+
+			/// Morpheme boundaries, from the end of the word backwards
+			std::vector<int> cuts;
+
+		public:
+
+			ViterbiSegmenter(const Model& _model)
+				:
+				  model(_model)
+			{}
+
+			///
+			/// \brief Call _f(morpheme) for each morpheme in the best
+			/// segmentation of a word
+			/// \param _word
+			/// \param _f
+			/// \return The cost of the segmentation
+			///
+			template <typename F>
+			real segment_word(const QStringView _word,
+							  F&& _f)
+			{
+				const int size(_word.size());
+				if (size == 0)
+				{
+					return 0.0;
+				}
+
+				best.assign(size + 1, std::numeric_limits<real>::infinity());
+				back.assign(size + 1, 0);
+				best[0] = 0.0;
+
+				for (int i = 0; i < size; ++i)
+				{
+					if (best[i] == std::numeric_limits<real>::infinity())
+					{
+						continue;
+					}
+
+					/// A single character is always possible
+					const int next(i + ((_word.at(i).isHighSurrogate()
+										 && i + 1 < size
+										 && _word.at(i + 1).isLowSurrogate()) ? 2 : 1));
+					const real single(best[i] + model.unknown_cost(_word.mid(i, next - i)));
+					if (single < best[next])
+					{
+						best[next] = single;
+						back[next] = i;
+					}
+
+					/// All morphemes starting at i
+					uint node(model.root());
+					for (int j = i; j < size; ++j)
+					{
+						node = model.step(node, _word.at(j));
+						if (node == Model::no_node)
+						{
+							break;
+						}
+
+						const real cost(best[i] + model.cost(node));
+						if (cost < best[j + 1])
+						{
+							best[j + 1] = cost;
+							back[j + 1] = i;
+						}
+					}
+				}
+
+				cuts.clear();
+				for (int end = size; end > 0; end = back[end])
+				{
+					cuts.push_back(end);
+				}
+				cuts.push_back(0);
+
+				for (uint c = cuts.size() - 1; c > 0; --c)
+				{
+					_f(_word.mid(cuts[c], cuts[c - 1] - cuts[c]));
+				}
+
+				return best[size];
+			}
+
+			///
+			/// \brief Append the best segmentation of a word to _out
+			/// \param _word
+			/// \param _out: morphemes are separated by spaces
+			/// \return The cost of the segmentation
+			///
+			inline real segment_word(const QStringView _word,
+									 QString& _out)
+			{
+				return segment_word(_word, [&](const QStringView _morpheme)
+				{
+					if (!_out.isEmpty())
+					{
+						_out.append(' ');
+					}
+					_out.append(_morpheme.data(), _morpheme.size());
+				});
+			}
+
+			///
+			/// \brief Segment each whitespace-delimited word of a text
+			/// \param _text
+			/// \return Morphemes separated by spaces
+			///
+			QString segment(const QStringView _text)
+			{
+				QString segmented;
+				segmented.reserve(_text.size() * 3 / 2);
+
+				const int size(_text.size());
+				int begin(0);
+				while (begin < size)
+				{
+					while (begin < size
+						   && _text.at(begin).isSpace())
+					{
+						++begin;
+					}
+
+					int end(begin);
+					while (end < size
+						   && !_text.at(end).isSpace())
+					{
+						++end;
+					}
+
+					segment_word(_text.mid(begin, end - begin), segmented);
+					begin = end;
+				}
+				return segmented;
+			}
+	};
+}
+
+#endif // VITERBISEGMENTER_HPP
@@ -0,0 +1,176 @@
+#include "Options.hpp"
+
+namespace Morpheus
+{
+	bool Options::confirm_on_exit;
+	bool Options::console_output;
+
+	uint Options::max_lines;
+	uint Options::lines_to_process_together;
+
+	/// Preprocessing options
+	bool Options::proc_lowercase;
+	bool Options::proc_remove_all_spaces;
+	bool Options::proc_remove_non_alnum;
+	bool Options::proc_remove_punctuation;
+	bool Options::proc_collapse_multiple_spaces;
+	bool Options::proc_keep_apostrophes;
+
+	/// Options to save the processed data into various files
+	bool Options::remember_last_open_dir;
+	QString Options::last_open_dir;
+	bool Options::autosave_stats;
+	bool Options::seg_method_ps_count;
+	bool Options::seg_method_ps_entropy;
+	bool Options::seg_method_character_frequencies;
+
+	/// Parallel extraction
+	uint Options::extraction_threads;
+	bool Options::deterministic_extraction;
+	bool Options::type_level_extraction;
+	uint Options::line_cache_size;
+
+	/// Resegmentation budget
+	uint Options::resegmentation_rounds;
+	uint Options::resegmentation_seconds;
+	bool Options::viterbi_resegmentation;
+
+	/// Semantics
+	uint Options::hidden_layer_size;
+
+	void Options::load(QSettings& _settings)
+	{
+		/////////
+		/// Files
+		/////////
+
+		_settings.beginGroup("file/open");
+		remember_last_open_dir = _settings.value("remember_last_open_dir", false).toBool();
+		last_open_dir = (remember_last_open_dir ? _settings.value("last_open_dir").toString() : "./");
+		_settings.endGroup();
+
+		//////////////
+		/// Morphology
+		//////////////
+
+		/// Preprocessing
+		_settings.beginGroup("morphology/preprocessing");
+		max_lines = _settings.value("max_lines_to_process", 1).toInt();
+		proc_remove_all_spaces = _settings.value("remove_all_spaces", false).toBool();
+		proc_collapse_multiple_spaces = _settings.value("collapse_multiple_spaces", false).toBool();
+		proc_remove_non_alnum = _settings.value("remove_non_alnum", false).toBool();
+		proc_remove_punctuation = _settings.value("remove_all_punctuation", false).toBool();
+		proc_lowercase = _settings.value("lowercase_everything", false).toBool();
+		proc_keep_apostrophes = _settings.value("keep_apostrophes", false).toBool();
+		_settings.endGroup();
+
+		/// Statistics
+		_settings.beginGroup("morphology/statistics");
+		seg_method_ps_count = _settings.value("segmentation_method/ps_count", true).toBool();
+		seg_method_ps_entropy = _settings.value("segmentation_method/ps_entropy", false).toBool();
+		seg_method_character_frequencies = _settings.value("segmentation_method/character_frequencies", false).toBool();
+		_settings.endGroup();
+
+		/// Parallel extraction
+		_settings.beginGroup("morphology/extraction");
+		extraction_threads = _settings.value("threads", 1).toUInt();
+		deterministic_extraction = _settings.value("deterministic", false).toBool();
+		type_level_extraction = _settings.value("type_level", false).toBool();
+		line_cache_size = _settings.value("line_cache_size", 10000).toUInt();
+		_settings.endGroup();
+
+		/// Resegmentation budget
+		_settings.beginGroup("morphology/resegmentation");
+		resegmentation_rounds = _settings.value("max_rounds", 20).toUInt();
+		resegmentation_seconds = _settings.value("max_seconds", 600).toUInt();
+		viterbi_resegmentation = _settings.value("viterbi", false).toBool();
+		_settings.endGroup();
+
+		/////////////
+		/// Semantics
+		/////////////
+
+		_settings.beginGroup("semantics/SENSE");
+		hidden_layer_size = _settings.value("hidden_layer_size", 300).toUInt();
+		_settings.endGroup();
+
+		///////////////////////////////
+		/// Program layout and settings
+		///////////////////////////////
+
+		_settings.beginGroup("program");
+		confirm_on_exit = _settings.value("confirm_on_exit", false).toBool();
+		console_output = _settings.value("console_output", false).toBool();
+		_settings.endGroup();
+	}
+
+	void Options::save(QSettings& _settings)
+	{
+		/////////
+		/// Files
+		/////////
+
+		_settings.beginGroup("file/open");
+		_settings.setValue("remember_last_open_dir", remember_last_open_dir);
+		if (!remember_last_open_dir)
+		{
+			last_open_dir = "./";
+		}
+		_settings.setValue("last_open_dir", last_open_dir);
+		_settings.endGroup();
+
+		//////////////
+		/// Morphology
+		//////////////
+
+		/// Preprocessing
+		_settings.beginGroup("morphology/preprocessing");
+		_settings.setValue("max_lines_to_process", max_lines);
+		_settings.setValue("remove_all_spaces", proc_remove_all_spaces);
+		_settings.setValue("collapse_multiple_spaces", proc_collapse_multiple_spaces);
+		_settings.setValue("remove_non_alnum", proc_remove_non_alnum);
+		_settings.setValue("remove_all_punctuation", proc_remove_punctuation);
+		_settings.setValue("lowercase_everything", proc_lowercase);
+		_settings.setValue("keep_apostrophes", proc_keep_apostrophes);
+		_settings.endGroup();
+
+		/// Statistics
+		_settings.beginGroup("morphology/statistics");
+		_settings.setValue("segmentation_method/ps_count", seg_method_ps_count);
+		_settings.setValue("segmentation_method/ps_entropy", seg_method_ps_entropy);
+		_settings.setValue("segmentation_method/character_frequencies", seg_method_character_frequencies);
+		_settings.endGroup();
+
+		/// Parallel extraction
+		_settings.beginGroup("morphology/extraction");
+		_settings.setValue("threads", extraction_threads);
+		_settings.setValue("deterministic", deterministic_extraction);
+		_settings.setValue("type_level", type_level_extraction);
+		_settings.setValue("line_cache_size", line_cache_size);
+		_settings.endGroup();
+
+		/// Resegmentation budget
+		_settings.beginGroup("morphology/resegmentation");
+		_settings.setValue("max_rounds", resegmentation_rounds);
+		_settings.setValue("max_seconds", resegmentation_seconds);
+		_settings.setValue("viterbi", viterbi_resegmentation);
+		_settings.endGroup();
+
+		/////////////
+		/// Semantics
+		/////////////
+
+		_settings.beginGroup("semantics/SENSE");
+		_settings.setValue("hidden_layer_size", hidden_layer_size);
+		_settings.endGroup();
+
+		///////////////////////////////
+		/// Program layout and settings
+		///////////////////////////////
+
+		_settings.beginGroup("program");
+		_settings.setValue("confirm_on_exit", confirm_on_exit);
+		_settings.setValue("console_output", console_output);
+		_settings.endGroup();
+	}
+}
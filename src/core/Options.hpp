@@ -0,0 +1,70 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include "Globals.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief Settings used by the processing core.
+	///
+	/// The options are loaded from and saved to QSettings without
+	/// any widgets, so they are available to the command-line tools.
+	/// The settings dialog (Config) derives from this class
+	/// and keeps its widgets in sync with the options.
+	///
+	class Options
+	{
+		public:
+
+			static bool confirm_on_exit;
+			static bool console_output;
+
+			static uint max_lines;
+			static uint lines_to_process_together;
+
+			/// Preprocessing options
+			static bool proc_lowercase;
+			static bool proc_remove_all_spaces;
+			static bool proc_remove_non_alnum;
+			static bool proc_remove_punctuation;
+			static bool proc_collapse_multiple_spaces;
+			static bool proc_keep_apostrophes;
+
+			/// Options to dump the processed data into various files
+			static bool remember_last_open_dir;
+			static QString last_open_dir;
+			static bool autosave_stats;
+			static bool seg_method_ps_count;
+			static bool seg_method_ps_entropy;
+			static bool seg_method_character_frequencies;
+
+			/// Parallel extraction
+			static uint extraction_threads;
+			static bool deterministic_extraction;
+			static bool type_level_extraction;
+			static uint line_cache_size;
+
+			/// Resegmentation budget
+			static uint resegmentation_rounds;
+			static uint resegmentation_seconds;
+			static bool viterbi_resegmentation;
+
+			/// Semantics
+			static uint hidden_layer_size;
+
+			///
+			/// \brief Read all options (missing ones get their defaults)
+			/// \param _settings
+			///
+			static void load(QSettings& _settings);
+
+			///
+			/// \brief Write all options
+			/// \param _settings
+			///
+			static void save(QSettings& _settings);
+	};
+}
+
+#endif // OPTIONS_HPP
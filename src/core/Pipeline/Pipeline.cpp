@@ -0,0 +1,605 @@
+#include "Pipeline.hpp"
+#include <mutex>
+#include <condition_variable>
+
+namespace Morpheus
+{
+	void Pipeline::add_timing(const QString& _stage,
+							  const std::chrono::steady_clock::time_point& _start,
+							  const uint _lines)
+	{
+		real seconds(duration_cast<nanoseconds>(std::chrono::steady_clock::now() - _start).count() / 1.0e9);
+		timings.push_back({_stage, seconds, _lines});
+	}
+
+	void Pipeline::begin_stage(uptr<MorphemeExtractor>&& _staging)
+	{
+		drop_staged();
+		staging = std::move(_staging);
+
+		/// Messages from the staging extractor reach the log through the pipeline
+		connect(staging.get(), &MorphemeExtractor::update_log, this, &Pipeline::update_log);
+	}
+
+	bool Pipeline::end_cancelled_stage()
+	{
+		progress->finish();
+		drop_staged();
+		return false;
+	}
+
+	bool Pipeline::set_input(const QString& _file_name)
+	{
+		if (!QFile::exists(_file_name))
+		{
+			clear_input();
+			return false;
+		}
+
+		QFileInfo fi(_file_name);
+		QDir dir(fi.absoluteDir());
+		QString base(fi.baseName());
+		QString ext(fi.completeSuffix());
+		pending.input = _file_name;
+		pending.processed = dir.absolutePath() + "/" + base + "_proc." + ext;
+		pending.segmented = dir.absolutePath() + "/" + base + "_seg." + ext;
+		pending.stats = dir.absolutePath() + "/" + base + "_stats.xml";
+		return true;
+	}
+
+	void Pipeline::clear_input()
+	{
+		pending = Files();
+	}
+
+	bool Pipeline::load_corpus()
+	{
+		begin_stage(std::make_unique<MorphemeExtractor>());
+		staged_corpus = true;
+
+		std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+		LineReader input;
+		QString error;
+		if (!input.open(pending.input, error))
+		{
+			drop_staged();
+			emit update_log("Cannot read " + pending.input + ": " + error);
+			return false;
+		}
+
+		/// The processed file of the loaded corpus may be the same file,
+		/// so the new one is written next to it until it is committed
+		QFile processed_file(get_staged_processed_file_name());
+		if (!processed_file.open(QFile::WriteOnly | QFile::Truncate))
+		{
+			drop_staged();
+			emit update_log("Cannot write " + processed_file.fileName() + ": " + processed_file.errorString());
+			return false;
+		}
+
+		/// The corpus is read once: each line is preprocessed, written to
+		/// the processed file and added to the staging extractor, which
+		/// counts its characters and keeps it for the suffix array.
+		/// Progress is measured in KiB read.
+		progress->begin("Reading the corpus...", static_cast<uint>(input.size() >> 10));
+
+		/// The suffix array and LineReader expect UTF-8
+		QTextStream processed_qts(&processed_file);
+		processed_qts.setCodec("UTF-8");
+
+		staged_lines = 0;
+		staging->begin_corpus();
+		ingest(input, processed_qts);
+
+		processed_qts.flush();
+		processed_file.close();
+		input.close();
+		if (cancel_token.is_cancelled())
+		{
+			return end_cancelled_stage();
+		}
+		add_timing("ingest", start, staged_lines);
+
+		/// Build the suffix array and compute the character statistics
+		start = std::chrono::steady_clock::now();
+		if (!staging->end_corpus(*progress, cancel_token))
+		{
+			return end_cancelled_stage();
+		}
+		add_timing("index", start, staged_lines);
+		progress->finish();
+
+		return true;
+	}
+
+	void Pipeline::ingest(LineReader& _input,
+						  QTextStream& _processed)
+	{
+		uint threads(Options::extraction_threads);
+		if (threads == 0)
+		{
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		/// Blocks which are being preprocessed or wait to be written
+		const uint max_blocks(2 * threads);
+		const uint input_kib(static_cast<uint>(_input.size() >> 10));
+
+		/// The preprocessed lines of a block and the input read up to its end
+		struct Block
+		{
+				QStringList lines;
+				qint64 end;
+		};
+
+		/// Reorder buffer: blocks which are done, by their index
+		std::map<uint, Block> done;
+		std::mutex mutex;
+		std::condition_variable block_done;
+		std::condition_variable block_written;
+		uint blocks_read(0);
+		uint blocks_written(0);
+		uint workers(threads);
+
+		auto preprocess = [&]
+		{
+			Preprocessor preprocessor;
+			QString line;
+			while (true)
+			{
+				LineReader::Line block;
+				uint index(0);
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					block_written.wait(lock, [&]
+					{
+						return cancel_token.is_cancelled()
+								|| blocks_read - blocks_written < max_blocks;
+					});
+
+					if (cancel_token.is_cancelled()
+						|| !_input.read_block(block, block_size))
+					{
+						--workers;
+						break;
+					}
+					index = blocks_read++;
+				}
+
+				Block result;
+				result.end = (block.data + block.size) - _input.data();
+
+				const char* pos(block.data);
+				const char* end(block.data + block.size);
+				LineReader::Line input_line;
+				while (LineReader::next_line(pos, end, input_line))
+				{
+					_input.decode(input_line, line);
+					QString processed_line(preprocessor.process_line(line));
+					if (processed_line.size() > 0)
+					{
+						result.lines.append(std::move(processed_line));
+					}
+				}
+
+				std::lock_guard<std::mutex> lock(mutex);
+				done.emplace(index, std::move(result));
+				block_done.notify_one();
+			}
+			block_done.notify_one();
+		};
+
+		std::vector<std::thread> pool;
+		for (uint t = 0; t < threads; ++t)
+		{
+			pool.emplace_back(preprocess);
+		}
+
+		/// Write the blocks in their original order
+		while (!cancel_token.is_cancelled())
+		{
+			Block block;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+
+				/// Wake up now and then to check for cancellation
+				block_done.wait_for(lock, std::chrono::milliseconds(100), [&]
+				{
+					return done.count(blocks_written) > 0
+							|| workers == 0;
+				});
+
+				std::map<uint, Block>::iterator it(done.find(blocks_written));
+				if (it == done.end())
+				{
+					if (workers == 0)
+					{
+						break;
+					}
+					continue;
+				}
+				block = std::move(it->second);
+				done.erase(it);
+				++blocks_written;
+			}
+			block_written.notify_all();
+
+			for (const QString& line : block.lines)
+			{
+				_processed << line << '\n';
+				staging->add_line(line);
+			}
+			staged_lines += block.lines.size();
+			progress->update("Reading the corpus...", static_cast<uint>(block.end >> 10), input_kib);
+		}
+
+		/// Let the workers return if the stage was cancelled
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+		}
+		block_written.notify_all();
+
+		for (std::thread& thread : pool)
+		{
+			thread.join();
+		}
+	}
+
+	bool Pipeline::extract_morphemes()
+	{
+		begin_stage(extractor.make_staging());
+		staging->clear(true);
+
+		/// Throughput
+		std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+		uint lines_extracted(0);
+		ullong chars_extracted(0);
+
+		LineReader processed;
+		QString error;
+		if (!processed.open(files.processed, error))
+		{
+			drop_staged();
+			emit update_log("Cannot read " + files.processed + ": " + error);
+			return false;
+		}
+
+		/// The segmented file is replaced only when the stage is committed
+		staged_output = std::make_unique<QSaveFile>(files.segmented);
+		if (!staged_output->open(QFile::WriteOnly | QFile::Text))
+		{
+			error = staged_output->errorString();
+			drop_staged();
+			emit update_log("Cannot write " + files.segmented + ": " + error);
+			return false;
+		}
+
+		QTextStream segmented_qts(staged_output.get());
+		QString line;
+		uint line_count(0);
+
+		const uint maximum(Options::max_lines == 0 ? lines : Options::max_lines);
+		progress->begin("Processing line 1/" + QString::number(maximum), maximum);
+
+		if (Options::extraction_threads != 1
+			|| Options::deterministic_extraction
+			|| Options::type_level_extraction)
+		{
+			/// Segment blocks of lines (or the distinct words) in parallel
+			/// and write the segmented lines as they become available
+			if (Options::type_level_extraction)
+			{
+				auto report = [&](const uint _done, const uint _total)
+				{
+					if (progress->due())
+					{
+						progress->update("Processing word " + QString::number(_done)
+										 + "/" + QString::number(_total), _done, _total);
+					}
+				};
+
+				lines_extracted = staging->extract_morphemes_by_type(processed,
+																	 segmented_qts,
+																	 Options::extraction_threads,
+																	 Options::deterministic_extraction,
+																	 chars_extracted,
+																	 report,
+																	 cancel_token);
+			}
+			else
+			{
+				auto report = [&](const uint _done)
+				{
+					if (progress->due())
+					{
+						progress->update("Processing line " + QString::number(_done)
+										 + "/" + QString::number(maximum), _done, maximum);
+					}
+				};
+
+				lines_extracted = staging->extract_morphemes(processed,
+															 segmented_qts,
+															 Options::extraction_threads,
+															 Options::deterministic_extraction,
+															 chars_extracted,
+															 report,
+															 cancel_token);
+			}
+		}
+		else
+		{
+			while (processed.read_line(line)
+				   && (Options::max_lines == 0
+					   || (Options::max_lines > 0
+						   && line_count < Options::max_lines
+						   )
+					   )
+				   && !cancel_token.is_cancelled()
+				   )
+			{
+				++line_count;
+				chars_extracted += line.size();
+
+				line.push_back('\n');
+				segmented_qts << staging->extract_morphemes(std::move(line)) << '\n';
+
+				/// Only build the label when it will be shown
+				if (progress->due())
+				{
+					progress->update("Processing line " + QString::number(line_count + 1)
+									 + "/" + QString::number(maximum)
+									 + "\nTotal morpheme count: " + QString::number(staging->get_total_morpheme_count())
+									 + "\nDistinct morphemes: " + QString::number(staging->get_dictionary_size()),
+									 line_count,
+									 maximum);
+				}
+			}
+			lines_extracted = line_count;
+		}
+
+		processed.close();
+		if (cancel_token.is_cancelled())
+		{
+			return end_cancelled_stage();
+		}
+		segmented_qts.flush();
+		progress->finish();
+
+		/// Run summary
+		real seconds(duration_cast<nanoseconds>(std::chrono::steady_clock::now() - start).count() / 1.0e9);
+		QString method(Options::seg_method_ps_count ? "predecessor / successor count"
+													: Options::seg_method_ps_entropy ? "predecessor / successor entropy"
+																					 : "character frequencies");
+		uint cache_lookups(staging->get_line_cache_lookups());
+		uint cache_hits(staging->get_line_cache_hits());
+		emit update_log("Extracted " + QString::number(staging->get_total_morpheme_count())
+						+ " morphemes (" + QString::number(staging->get_dictionary_size()) + " distinct)"
+						+ " using " + method + " in " + QString::number(seconds, 'f', 2) + " s"
+						+ "\nThroughput: " + QString::number(seconds > 0.0 ? lines_extracted / seconds : 0.0, 'f', 1) + " lines/s, "
+						+ QString::number(seconds > 0.0 ? chars_extracted / seconds : 0.0, 'f', 0) + " characters/s"
+						+ "\nLine cache hits: " + QString::number(cache_hits) + "/" + QString::number(cache_lookups)
+						+ " (" + QString::number(cache_lookups > 0 ? 100.0 * cache_hits / cache_lookups : 0.0, 'f', 1) + "%)"
+						+ "\nDictionary: " + QString::number(staging->get_dictionary().get_node_count()) + " trie nodes in "
+						+ QString::number(staging->get_dictionary().get_memory() / 1024.0, 'f', 0) + " KB");
+
+		staging->clear();
+		add_timing("extract", start, lines_extracted);
+
+		return true;
+	}
+
+	bool Pipeline::resegment_morphemes()
+	{
+		begin_stage(extractor.make_staging());
+
+		std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+		QFile segmented_file(files.segmented);
+		if (!segmented_file.open(QFile::ReadOnly | QFile::Text))
+		{
+			drop_staged();
+			emit update_log("Cannot read " + segmented_file.fileName() + ": " + segmented_file.errorString());
+			return false;
+		}
+
+		/// The Viterbi pass takes the word boundaries from the preprocessed text
+		LineReader processed;
+		QString error;
+		if (Options::viterbi_resegmentation
+			&& !processed.open(files.processed, error))
+		{
+			segmented_file.close();
+			drop_staged();
+			emit update_log("Cannot read " + files.processed + ": " + error);
+			return false;
+		}
+
+		/// The new segmentation is written to a temporary file
+		/// which replaces the old one when the stage is committed
+		staged_output = std::make_unique<QSaveFile>(files.segmented);
+		if (!staged_output->open(QFile::WriteOnly | QFile::Text))
+		{
+			segmented_file.close();
+			processed.close();
+			error = staged_output->errorString();
+			drop_staged();
+			emit update_log("Cannot write " + files.segmented + ": " + error);
+			return false;
+		}
+
+		/// Compute the initial dictionary cost and entropy
+		staging->init_entropy();
+
+		QTextStream segmented_qts(&segmented_file);
+		QTextStream reseg_qts(staged_output.get());
+
+		progress->begin("Resegmenting");
+		const uint line_count(staging->resegment_morphemes(segmented_qts, processed, reseg_qts, [&](const uint _operations, const real _length)
+		{
+			if (progress->due())
+			{
+				progress->update("Resegmenting"
+								 "\nOperations: " + QString::number(_operations)
+								 + "\nDescription length: " + QString::number(_length, 'f', 1),
+								 0,
+								 0);
+			}
+		}, cancel_token));
+
+		segmented_file.close();
+		processed.close();
+		if (cancel_token.is_cancelled())
+		{
+			return end_cancelled_stage();
+		}
+		reseg_qts.flush();
+		progress->finish();
+
+		add_timing("resegment", start, line_count);
+		return true;
+	}
+
+	bool Pipeline::commit()
+	{
+		if (!staging)
+		{
+			return false;
+		}
+
+		/// The old preprocessed corpus is kept until everything
+		/// has been saved, so it can be put back after a failure
+		const QString old_processed(pending.processed + ".old");
+		bool kept_old(false);
+		if (staged_corpus)
+		{
+			QFile::remove(old_processed);
+			kept_old = QFile::rename(pending.processed, old_processed);
+			if (QFile::exists(pending.processed)
+				|| !QFile::rename(get_staged_processed_file_name(), pending.processed))
+			{
+				emit update_log("Cannot save " + pending.processed);
+				if (kept_old)
+				{
+					QFile::rename(old_processed, pending.processed);
+				}
+				discard();
+				return false;
+			}
+		}
+
+		if (staged_output
+			&& !staged_output->commit())
+		{
+			emit update_log("Cannot save " + staged_output->fileName() + ": " + staged_output->errorString());
+			if (staged_corpus)
+			{
+				QFile::remove(pending.processed);
+				if (kept_old)
+				{
+					QFile::rename(old_processed, pending.processed);
+				}
+				staged_corpus = false;
+			}
+			discard();
+			return false;
+		}
+
+		if (kept_old)
+		{
+			QFile::remove(old_processed);
+		}
+
+		if (staged_corpus)
+		{
+			files = pending;
+			lines = staged_lines;
+		}
+
+		extractor.adopt(*staging);
+		staged_output.reset();
+		staging.reset();
+		staged_corpus = false;
+		cancel_token.reset();
+		return true;
+	}
+
+	void Pipeline::discard()
+	{
+		drop_staged();
+		cancel_token.reset();
+	}
+
+	void Pipeline::drop_staged()
+	{
+		if (staged_output)
+		{
+			staged_output->cancelWriting();
+			staged_output.reset();
+		}
+
+		if (staged_corpus)
+		{
+			QFile::remove(get_staged_processed_file_name());
+			staged_corpus = false;
+		}
+
+		staging.reset();
+	}
+
+	bool Pipeline::save_stats()
+	{
+		std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+		pugi::xml_document stats;
+		pugi::xml_node root = stats.append_child("Statistics");
+		pugi::xml_node parameters = root.append_child("Parameters");
+
+		/// Dump the parameters which were used to extract these stats
+		parameters.append_child("max_lines").text().set(Options::max_lines);
+		parameters.append_child("process_lowercase").text().set(Options::proc_lowercase);
+		parameters.append_child("process_remove_spaces").text().set(Options::proc_remove_all_spaces);
+		parameters.append_child("process_remove_punctuation").text().set(Options::proc_remove_punctuation);
+		parameters.append_child("process_replace_multiple_spaces").text().set(Options::proc_collapse_multiple_spaces);
+
+		pugi::xml_node parameter = parameters.append_child("remember_last_input_file");
+		parameter.text().set(Options::remember_last_open_dir);
+		parameter.append_attribute("file_name").set_value(Options::last_open_dir.toUtf8().constData());
+
+		if (extractor.get_alphabet().size() > 0)
+		{
+			pugi::xml_node character_root = root.append_child("characters");
+			pugi::xml_node character_node;
+
+			const QHash<QChar, uint>& characters(extractor.get_alphabet());
+			for (QHash<QChar, uint>::const_iterator it = characters.constBegin(); it != characters.constEnd(); ++it)
+			{
+				character_node = character_root.append_child("char");
+				character_node.append_attribute("occurrences").set_value(it.value());
+				character_node.text().set(QString(it.key()).toUtf8().constData());
+			}
+		}
+
+		if (extractor.get_dictionary().size() > 0)
+		{
+			pugi::xml_node morpheme_root = root.append_child("morphemes");
+			pugi::xml_node morpheme_node;
+			const MorphemeDictionary& morphemes(extractor.get_dictionary());
+			for (const uint node : morphemes.by_frequency())
+			{
+				morpheme_node = morpheme_root.append_child("morpheme");
+				morpheme_node.append_attribute("occurrences").set_value(morphemes.count(node));
+				morpheme_node.text().set(morphemes.morpheme(node).toUtf8().constData());
+			}
+		}
+
+		if (!stats.save_file(files.stats.toUtf8().constData()))
+		{
+			emit update_log("Cannot write " + files.stats);
+			return false;
+		}
+
+		add_timing("save_stats", start, lines);
+		return true;
+	}
+}
@@ -0,0 +1,268 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include "Globals.hpp"
+#include "Options.hpp"
+#include "ProgressSink.hpp"
+#include "CancellationToken.hpp"
+#include "Preprocessor.hpp"
+#include "LineReader.hpp"
+#include "MorphemeExtractor.hpp"
+
+namespace Morpheus
+{
+	///
+	/// \brief The processing stages applied to a corpus:
+	/// preprocessing and indexing (load_corpus()), morpheme extraction,
+	/// resegmentation and saving the statistics.
+	///
+	/// The pipeline only uses the processing core, so it runs the same
+	/// way under the GUI and from the command line. Progress is passed
+	/// to a ProgressSink and messages are sent through update_log().
+	/// The wall-clock time of each stage is recorded.
+	///
+	/// A stage may run on a worker thread. It only reads the extractor
+	/// and builds its results in a staging extractor and in temporary files.
+	/// commit() then installs the results on the thread which owns the
+	/// extractor, while discard() drops them. A stage which fails or is
+	/// cancelled (see cancel()) leaves the loaded corpus, the suffix array,
+	/// the dictionary and the files as they were.
+	///
+	class Pipeline : public QObject
+	{
+			Q_OBJECT
+
+		public:
+
+			/// Time spent in a stage
+			struct Timing
+			{
+					QString stage;
+					real seconds;
+
+					/// Number of lines processed
+					uint lines;
+			};
+
+		private:
+
+			/// The files derived from a corpus
+			struct Files
+			{
+					/// The corpus
+					QString input;
+
+					/// The preprocessed corpus (file_proc.ext)
+					QString processed;
+
+					/// The segmented corpus (file_seg.ext)
+					QString segmented;
+
+					/// Statistics about characters and morphemes (file_stats.xml)
+					QString stats;
+			};
+
+			MorphemeExtractor& extractor;
+
+			/// The files of the loaded corpus
+			Files files;
+
+			/// The files of the corpus set with set_input()
+			Files pending;
+
+			/// The number of lines in the preprocessed corpus
+			uint lines;
+
+			/// Receives progress reports
+			ProgressSink* progress;
+
+			/// Set by cancel() and reset by commit() or discard(),
+			/// so a stage cancelled before it starts does not run
+			CancellationToken cancel_token;
+
+			/// Results of the last stage which have not been committed
+			uptr<MorphemeExtractor> staging;
+
+			/// The segmented corpus written by the last stage
+			uptr<QSaveFile> staged_output;
+
+			/// The number of lines in the corpus loaded by the last stage
+			uint staged_lines;
+
+			/// Whether the last stage loaded a corpus
+			bool staged_corpus;
+
+			/// Timings of the stages run so far
+			std::vector<Timing> timings;
+
+			/// Record the time since _start for a stage
+			void add_timing(const QString& _stage,
+							const std::chrono::steady_clock::time_point& _start,
+							const uint _lines);
+
+			/// Bytes of the corpus which are preprocessed together
+			static constexpr int block_size = 1 << 22;
+
+			///
+			/// \brief Preprocess the corpus in blocks of whole lines on
+			/// several threads (Options::extraction_threads) and pass the lines
+			/// in their original order to the processed file and the staging
+			/// extractor. At most two blocks per thread are held in memory.
+			/// \param _input
+			/// \param _processed
+			///
+			void ingest(LineReader& _input,
+						QTextStream& _processed);
+
+			/// Start a stage on a new staging extractor
+			void begin_stage(uptr<MorphemeExtractor>&& _staging);
+
+			/// Drop the staging extractor and the temporary files
+			void drop_staged();
+
+			///
+			/// \brief Drop the results of a cancelled stage
+			/// \return false
+			///
+			bool end_cancelled_stage();
+
+			/// The preprocessed corpus is written here until it is committed
+			inline QString get_staged_processed_file_name() const
+			{
+				return pending.processed + ".tmp";
+			}
+
+		public:
+
+			///
+			/// \param _extractor: the extractor which holds the characters,
+			/// the suffix array and the dictionary
+			///
+			Pipeline(MorphemeExtractor& _extractor)
+				:
+				  extractor(_extractor),
+				  lines(0),
+				  progress(&ProgressSink::none()),
+				  staged_lines(0),
+				  staged_corpus(false)
+			{}
+
+			~Pipeline()
+			{
+				discard();
+			}
+
+			///
+			/// \brief Set the sink which receives progress reports.
+			/// Each stage calls ProgressSink::finish() when it ends.
+			/// \param _progress: must outlive the pipeline
+			///
+			inline void set_progress(ProgressSink& _progress)
+			{
+				progress = &_progress;
+			}
+
+			///
+			/// \brief Set the corpus for the next load_corpus() and derive
+			/// the names of the processed, segmented and statistics files from it
+			/// \param _file_name
+			/// \return Whether the corpus exists
+			///
+			bool set_input(const QString& _file_name);
+
+			/// Forget the corpus set with set_input()
+			void clear_input();
+
+			inline QString get_input_file_name() const
+			{
+				return files.input;
+			}
+
+			inline QString get_processed_file_name() const
+			{
+				return files.processed;
+			}
+
+			inline QString get_segmented_file_name() const
+			{
+				return files.segmented;
+			}
+
+			inline QString get_stats_file_name() const
+			{
+				return files.stats;
+			}
+
+			/// The number of lines in the preprocessed corpus
+			inline uint get_line_count() const
+			{
+				return lines;
+			}
+
+			/// Timings of the stages run so far
+			inline const std::vector<Timing>& get_timings() const
+			{
+				return timings;
+			}
+
+			///
+			/// \brief Ask the running stage to stop.
+			/// May be called from any thread.
+			///
+			inline void cancel()
+			{
+				cancel_token.cancel();
+			}
+
+			inline bool is_cancelled() const
+			{
+				return cancel_token.is_cancelled();
+			}
+
+			///
+			/// \brief Preprocess the corpus set with set_input(),
+			/// then extract the characters and build the suffix array
+			/// \return Whether the corpus was loaded (false if cancelled)
+			///
+			bool load_corpus();
+
+			///
+			/// \brief Segment the processed corpus
+			/// \return Whether the corpus was segmented (false if cancelled)
+			///
+			bool extract_morphemes();
+
+			///
+			/// \brief Resegment the segmented corpus (see MorphemeExtractor::resegment_morphemes())
+			/// \return Whether the corpus was resegmented (false if cancelled)
+			///
+			bool resegment_morphemes();
+
+			///
+			/// \brief Install the results of the last stage: move its files
+			/// into place and hand its extractor over to the live one.
+			/// Must be called on the thread which owns the extractor.
+			/// \return Whether the files could be replaced
+			///
+			bool commit();
+
+			///
+			/// \brief Drop the results of the last stage
+			/// (which may have been cancelled)
+			///
+			void discard();
+
+			///
+			/// \brief Save the settings, the characters and the morphemes
+			/// to the statistics file
+			/// \return Whether the file was written
+			///
+			bool save_stats();
+
+		signals:
+
+			void update_log(const QString& _message);
+	};
+}
+
+#endif // PIPELINE_HPP
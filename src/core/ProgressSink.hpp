@@ -0,0 +1,211 @@
+#ifndef PROGRESSSINK_HPP
+#define PROGRESSSINK_HPP
+
+#include "Globals.hpp"
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace Morpheus
+{
+	///
+	/// \brief Receives progress reports from long-running stages.
+	///
+	/// begin() and finish() are always passed on to the sink,
+	/// but update() reaches it at most once per interval
+	/// (ten times per second by default), so it can be called
+	/// from hot loops. Callers which build an expensive label
+	/// should check due() first. Nothing here touches the event loop;
+	/// a sink which needs it does so in show().
+	///
+	class ProgressSink
+	{
+		public:
+
+			using clock = std::chrono::steady_clock;
+
+		private:
+
+			/// Minimum time between two updates
+			clock::duration interval;
+
+			/// The earliest time for the next update
+			clock::time_point next;
+
+		protected:
+
+			///
+			/// \brief Display a report
+			/// \param _stage: a label (the first line is the name of the stage)
+			/// \param _done
+			/// \param _total: 0 if the amount of work is not known
+			///
+			virtual void show(const QString& _stage,
+							  const uint _done,
+							  const uint _total) = 0;
+
+			/// All stages have finished
+			virtual void close() {}
+
+		public:
+
+			ProgressSink(const clock::duration _interval = std::chrono::milliseconds(100))
+				:
+				  interval(_interval),
+				  next(clock::time_point::min())
+			{}
+
+			virtual ~ProgressSink() {}
+
+			/// A sink which ignores all reports
+			static ProgressSink& none();
+
+			/// Whether an update would be shown now
+			inline bool due() const
+			{
+				return clock::now() >= next;
+			}
+
+			/// Start a stage
+			inline void begin(const QString& _stage,
+							  const uint _total = 0)
+			{
+				next = clock::now() + interval;
+				show(_stage, 0, _total);
+			}
+
+			/// Report the progress of the current stage (throttled)
+			inline void update(const QString& _stage,
+							   const uint _done,
+							   const uint _total)
+			{
+				const clock::time_point now(clock::now());
+				if (now >= next)
+				{
+					next = now + interval;
+					show(_stage, _done, _total);
+				}
+			}
+
+			/// End the last stage
+			inline void finish()
+			{
+				next = clock::time_point::min();
+				close();
+			}
+	};
+
+	///
+	/// \brief Ignores all reports
+	///
+	class NullProgress : public ProgressSink
+	{
+		protected:
+
+			void show(const QString&,
+					  const uint,
+					  const uint) override
+			{}
+
+		public:
+
+			/// Updates are (practically) never due
+			NullProgress()
+				:
+				  ProgressSink(std::chrono::hours(24))
+			{}
+	};
+
+	inline ProgressSink& ProgressSink::none()
+	{
+		static NullProgress sink;
+		return sink;
+	}
+
+	///
+	/// \brief Writes the name of the stage and the counts
+	/// over a single line of a terminal
+	///
+	class ConsoleProgress : public ProgressSink
+	{
+		private:
+
+			std::ostream& out;
+
+		protected:
+
+			void show(const QString& _stage,
+					  const uint _done,
+					  const uint _total) override
+			{
+				out << '\r' << _stage.section('\n', 0, 0).toLocal8Bit().constData();
+				if (_total > 0)
+				{
+					out << " (" << _done << "/" << _total << ")";
+				}
+				out << "\033[K" << std::flush;
+			}
+
+			void close() override
+			{
+				out << std::endl;
+			}
+
+		public:
+
+			ConsoleProgress(std::ostream& _out = std::cerr)
+				:
+				  out(_out)
+			{}
+	};
+
+	///
+	/// \brief Writes each report as a JSON object on a line of its own:
+	/// {"stage": ..., "done": ..., "total": ..., "seconds": ...}
+	/// and {"finished": true, "seconds": ...} at the end
+	///
+	class JsonProgress : public ProgressSink
+	{
+		private:
+
+			std::ostream& out;
+
+			clock::time_point start;
+
+			inline real seconds() const
+			{
+				return duration_cast<nanoseconds>(clock::now() - start).count() / 1.0e9;
+			}
+
+		protected:
+
+			void show(const QString& _stage,
+					  const uint _done,
+					  const uint _total) override
+			{
+				QJsonObject report;
+				report["stage"] = _stage.section('\n', 0, 0);
+				report["done"] = static_cast<qint64>(_done);
+				report["total"] = static_cast<qint64>(_total);
+				report["seconds"] = seconds();
+				out << QJsonDocument(report).toJson(QJsonDocument::Compact).constData() << std::endl;
+			}
+
+			void close() override
+			{
+				QJsonObject report;
+				report["finished"] = true;
+				report["seconds"] = seconds();
+				out << QJsonDocument(report).toJson(QJsonDocument::Compact).constData() << std::endl;
+			}
+
+		public:
+
+			JsonProgress(std::ostream& _out = std::cerr)
+				:
+				  out(_out),
+				  start(clock::now())
+			{}
+	};
+}
+
+#endif // PROGRESSSINK_HPP
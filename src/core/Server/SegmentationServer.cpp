@@ -0,0 +1,245 @@
+#include "SegmentationServer.hpp"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace Morpheus
+{
+	SegmentationServer::~SegmentationServer()
+	{
+		stop();
+	}
+
+	bool SegmentationServer::start(const QString& _name,
+								   uint _threads)
+	{
+		/// Remove a socket left behind by a server which did not exit cleanly
+		QLocalServer::removeServer(_name);
+		if (!server.listen(_name))
+		{
+			return false;
+		}
+
+		connect(&server, &QLocalServer::newConnection, this, &SegmentationServer::accept_connections);
+
+		if (_threads == 0)
+		{
+			_threads = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+		for (uint t = 0; t < _threads; ++t)
+		{
+			threads.emplace_back([this]
+			{
+				uptr<MorphemeExtractor> worker(extractor.make_worker());
+				run_worker(*worker);
+			});
+		}
+
+		emit update_log("Listening on " + server.fullServerName()
+						+ " with " + QString::number(_threads) + " worker" + (_threads > 1 ? "s" : ""));
+		return true;
+	}
+
+	void SegmentationServer::stop()
+	{
+		server.close();
+
+		{
+			std::lock_guard<std::mutex> lock(requests_mutex);
+			stopping = true;
+		}
+		requests_cv.notify_all();
+
+		if (threads.empty())
+		{
+			return;
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+		threads.clear();
+
+		/// disconnected() can be emitted from disconnectFromServer(),
+		/// and its handler removes the socket from connections
+		const QList<QLocalSocket*> sockets(connections.values());
+		connections.clear();
+		for (QLocalSocket* socket : sockets)
+		{
+			socket->disconnectFromServer();
+		}
+
+		emit update_log("Served " + QString::number(requests_served) + " requests");
+	}
+
+	void SegmentationServer::accept_connections()
+	{
+		while (QLocalSocket* socket = server.nextPendingConnection())
+		{
+			const quint64 id(next_connection++);
+			connections[id] = socket;
+
+			connect(socket, &QLocalSocket::readyRead, this, [this, id]
+			{
+				read_requests(id);
+			});
+
+			connect(socket, &QLocalSocket::disconnected, this, [this, id, socket]
+			{
+				connections.remove(id);
+				socket->deleteLater();
+			});
+		}
+	}
+
+	void SegmentationServer::read_requests(const quint64 _connection)
+	{
+		QLocalSocket* socket(connections.value(_connection, nullptr));
+		if (socket == nullptr)
+		{
+			return;
+		}
+
+		std::chrono::steady_clock::time_point received(std::chrono::steady_clock::now());
+		bool queued(false);
+		{
+			std::lock_guard<std::mutex> lock(requests_mutex);
+			while (socket->canReadLine())
+			{
+				QByteArray data(socket->readLine().trimmed());
+				if (!data.isEmpty())
+				{
+					requests.push_back({_connection, std::move(data), received});
+					queued = true;
+				}
+			}
+		}
+
+		if (queued)
+		{
+			requests_cv.notify_all();
+		}
+	}
+
+	void SegmentationServer::run_worker(MorphemeExtractor& _worker)
+	{
+		while (true)
+		{
+			Request request;
+			{
+				std::unique_lock<std::mutex> lock(requests_mutex);
+				requests_cv.wait(lock, [this]
+				{
+					return stopping || !requests.empty();
+				});
+
+				if (stopping)
+				{
+					return;
+				}
+
+				request = std::move(requests.front());
+				requests.pop_front();
+			}
+
+			send(request.connection, handle(_worker, request));
+			++requests_served;
+		}
+	}
+
+	QByteArray SegmentationServer::handle(MorphemeExtractor& _worker,
+										  const Request& _request)
+	{
+		std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+		QJsonParseError parse_error;
+		const QJsonDocument document(QJsonDocument::fromJson(_request.data, &parse_error));
+		const QJsonObject query(document.object());
+
+		QJsonObject reply;
+		reply["id"] = query.value("id");
+
+		const QString op(query.value("op").toString());
+		if (parse_error.error != QJsonParseError::NoError
+			|| !document.isObject())
+		{
+			reply["error"] = "Malformed request: " + parse_error.errorString();
+		}
+		else if (op == "segment")
+		{
+			Preprocessor preprocessor;
+			QJsonArray lines;
+			for (const QJsonValue& line : query.value("lines").toArray())
+			{
+				lines.append(extractor.segment_text(preprocessor.process_line(line.toString())));
+			}
+			reply["lines"] = lines;
+		}
+		else if (op == "stats")
+		{
+			QJsonArray strings;
+			for (const QJsonValue& value : query.value("strings").toArray())
+			{
+				const QString string(value.toString());
+				const MorphemeExtractor::StringStats stats(_worker.get_string_stats(string, extractor.get_dictionary()));
+
+				QJsonObject entry;
+				entry["string"] = string;
+				entry["occurrences"] = static_cast<qint64>(stats.occurrences);
+				entry["distinct_predecessors"] = static_cast<qint64>(stats.distinct_predecessors);
+				entry["distinct_successors"] = static_cast<qint64>(stats.distinct_successors);
+				entry["predecessor_entropy"] = stats.predecessor_entropy;
+				entry["successor_entropy"] = stats.successor_entropy;
+				entry["morpheme_count"] = static_cast<qint64>(stats.morpheme_count);
+				strings.append(entry);
+			}
+			reply["strings"] = strings;
+		}
+		else if (op == "prefix"
+				 || op == "suffix")
+		{
+			const MorphemeDictionary& dictionary(extractor.get_dictionary());
+			const QString string(Preprocessor().process_line(query.value("string").toString()));
+			const uint max(static_cast<uint>(std::max(query.value("max").toInt(100), 0)));
+			const QStringList found(op == "prefix" ? dictionary.with_prefix(string, max)
+												   : dictionary.with_suffix(string, max));
+
+			QJsonArray morphemes;
+			for (const QString& morpheme : found)
+			{
+				QJsonObject entry;
+				entry["morpheme"] = morpheme;
+				entry["occurrences"] = static_cast<qint64>(dictionary.value(morpheme));
+				morphemes.append(entry);
+			}
+			reply["morphemes"] = morphemes;
+		}
+		else
+		{
+			reply["error"] = "Unknown operation: " + op;
+		}
+
+		/// Latency
+		std::chrono::steady_clock::time_point end(std::chrono::steady_clock::now());
+		reply["queued_ms"] = duration_cast<nanoseconds>(start - _request.received).count() / 1.0e6;
+		reply["processed_ms"] = duration_cast<nanoseconds>(end - start).count() / 1.0e6;
+
+		return QJsonDocument(reply).toJson(QJsonDocument::Compact);
+	}
+
+	void SegmentationServer::send(const quint64 _connection,
+								  const QByteArray& _reply)
+	{
+		/// Sockets can only be used on the thread of the server
+		QMetaObject::invokeMethod(this, [this, _connection, _reply]
+		{
+			if (QLocalSocket* socket = connections.value(_connection, nullptr))
+			{
+				socket->write(_reply);
+				socket->write("\n", 1);
+			}
+		}, Qt::QueuedConnection);
+	}
+}
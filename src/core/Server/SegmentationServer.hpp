@@ -0,0 +1,140 @@
+#ifndef SEGMENTATIONSERVER_HPP
+#define SEGMENTATIONSERVER_HPP
+
+#include "Globals.hpp"
+#include "Preprocessor.hpp"
+#include "MorphemeExtractor.hpp"
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <mutex>
+#include <condition_variable>
+
+namespace Morpheus
+{
+	///
+	/// \brief Answers segmentation and statistics queries over a local socket
+	/// using a MorphemeExtractor which has been trained on a corpus.
+	///
+	/// The trained dictionary is only read, so the replies do not depend
+	/// on which worker answers or on the requests served before.
+	/// Lines are segmented with the dictionary (see MorphemeExtractor::segment_text()).
+	/// Each worker thread keeps its own suffix array caches for the
+	/// statistics (see MorphemeExtractor::make_worker()) for as long
+	/// as the server runs, so the caches stay warm between requests.
+	///
+	/// Protocol: one JSON object per line in each direction.
+	///   {"id": 1, "op": "segment", "lines": ["...", ...]}
+	///     -> {"id": 1, "lines": ["seg ment ed", ...], "queued_ms": ..., "processed_ms": ...}
+	///   {"id": 2, "op": "stats", "strings": ["...", ...]}
+	///     -> {"id": 2, "strings": [{"string": ..., "occurrences": ..., ...}, ...], ...}
+	///   {"id": 3, "op": "prefix" (or "suffix"), "string": "...", "max": 100}
+	///     -> {"id": 3, "morphemes": [{"morpheme": ..., "occurrences": ...}, ...], ...}
+	///     (the morphemes which start or end with the string; "max" is optional, 0 for all)
+	/// Requests are handled concurrently, so replies may arrive out of order
+	/// and should be matched by their id. Malformed requests receive {"id": ..., "error": "..."}.
+	/// The lines are preprocessed like the corpus before they are segmented.
+	///
+	class SegmentationServer : public QObject
+	{
+			Q_OBJECT
+
+		private:
+
+			struct Request
+			{
+					/// The connection which sent the request
+					quint64 connection;
+
+					QByteArray data;
+
+					std::chrono::steady_clock::time_point received;
+			};
+
+			/// The trained extractor (never modified)
+			const MorphemeExtractor& extractor;
+
+			QLocalServer server;
+
+			/// Open connections by id
+			QHash<quint64, QLocalSocket*> connections;
+			quint64 next_connection;
+
+			/// Requests waiting for a worker
+			std::deque<Request> requests;
+			std::mutex requests_mutex;
+			std::condition_variable requests_cv;
+			bool stopping;
+
+			std::vector<std::thread> threads;
+
+			/// Requests answered so far
+			std::atomic<ullong> requests_served;
+
+			void accept_connections();
+
+			void read_requests(const quint64 _connection);
+
+			///
+			/// \brief Take requests from the queue until the server stops
+			/// \param _worker: holds the suffix array caches of this thread
+			///
+			void run_worker(MorphemeExtractor& _worker);
+
+			///
+			/// \brief Handle a single request
+			/// \param _worker
+			/// \param _request
+			/// \return The reply (without the trailing newline)
+			///
+			QByteArray handle(MorphemeExtractor& _worker,
+							  const Request& _request);
+
+			/// Write a reply to a connection (on the thread of the server)
+			void send(const quint64 _connection,
+					  const QByteArray& _reply);
+
+		public:
+
+			///
+			/// \param _extractor: an extractor with a loaded corpus and a dictionary,
+			/// which must not change while the server runs
+			///
+			SegmentationServer(const MorphemeExtractor& _extractor)
+				:
+				  extractor(_extractor),
+				  next_connection(0),
+				  stopping(false),
+				  requests_served(0)
+			{}
+
+			~SegmentationServer();
+
+			///
+			/// \brief Start the worker threads and listen on a local socket
+			/// \param _name: the socket name or path (see QLocalServer::listen())
+			/// \param _threads: number of worker threads (0 for all available cores)
+			/// \return Whether the server is listening
+			///
+			bool start(const QString& _name,
+					   uint _threads);
+
+			/// Stop listening and wait for the workers to finish
+			void stop();
+
+			inline QString get_error() const
+			{
+				return server.errorString();
+			}
+
+			inline QString get_server_name() const
+			{
+				return server.fullServerName();
+			}
+
+		signals:
+
+			void update_log(const QString& _message);
+	};
+}
+
+#endif // SEGMENTATIONSERVER_HPP
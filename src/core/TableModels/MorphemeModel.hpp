@@ -59,11 +59,11 @@ namespace Morpheus
 					switch (_index.column())
 					{
 						case 0:
-							return me->dictionary_vector[_index.row()].first;
+							return me->get_dictionary().morpheme(me->dictionary_vector[_index.row()]);
 							break;
 
 						case 1:
-							return me->dictionary_vector[_index.row()].second;
+							return me->get_dictionary().count(me->dictionary_vector[_index.row()]);
 							break;
 					}
 				}
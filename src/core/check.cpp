@@ -0,0 +1,340 @@
+#include "Globals.hpp"
+#include "Options.hpp"
+#include "Preprocessor.hpp"
+#include "LineReader.hpp"
+#include <QTemporaryFile>
+#include <random>
+
+///
+/// \brief Checks that the fast corpus paths give the same output
+/// as the straightforward code they replaced:
+///
+/// - Preprocessor (table-driven, single pass) against the per-character
+///   rules followed by QString::simplified() and removal of spaces,
+///   for every combination of the preprocessing options.
+/// - LineReader::decode() against QString::fromUtf8() on files mixing
+///   ASCII, BMP characters, surrogate pairs and invalid UTF-8.
+///
+/// Usage: morpheus-check
+/// Returns 0 if all checks pass.
+///
+namespace
+{
+	using namespace Morpheus;
+
+	/// Number of failures reported in full before the rest are only counted
+	const uint max_reports(20);
+
+	uint failures(0);
+
+	void report(const std::string& _what,
+				const QString& _input,
+				const QString& _expected,
+				const QString& _actual)
+	{
+		if (++failures > max_reports)
+		{
+			return;
+		}
+
+		auto hex = [](const QString& _str)
+		{
+			std::ostringstream out;
+			for (const QChar ch : _str)
+			{
+				out << ' ' << std::hex << std::setw(4) << std::setfill('0') << ch.unicode();
+			}
+			return out.str();
+		};
+
+		std::cerr << "FAIL " << _what << "\n"
+				  << "  input:   " << hex(_input) << "\n"
+				  << "  expected:" << hex(_expected) << "\n"
+				  << "  actual:  " << hex(_actual) << std::endl;
+	}
+
+	///
+	/// \brief Preprocessing as it was done before the options were compiled
+	/// into a table: the rules applied to each character, then simplified()
+	/// and a second removal of spaces
+	/// \param _line
+	/// \return
+	///
+	QString reference_process_line(const QString& _line)
+	{
+		QString processed_line;
+		for (const QChar ch : _line)
+		{
+			if ((ch.isSpace()
+				 && Options::proc_remove_all_spaces
+				 )
+				|| (!ch.isLetterOrNumber()
+					&& Options::proc_remove_non_alnum
+					)
+				|| (ch.isPunct()
+					&& Options::proc_remove_punctuation
+					)
+				)
+			{
+				if (ch == '\''
+					&& Options::proc_keep_apostrophes)
+				{
+					processed_line.append('\'');
+				}
+				else
+				{
+					continue;
+				}
+			}
+
+			processed_line.append(Options::proc_lowercase ? ch.toLower() : ch);
+		}
+
+		if (Options::proc_collapse_multiple_spaces)
+		{
+			processed_line = processed_line.simplified();
+			if (Options::proc_remove_all_spaces)
+			{
+				processed_line.replace(" ", "");
+			}
+		}
+		return processed_line;
+	}
+
+	void check_preprocessor()
+	{
+		/// Every UTF-16 code unit (including lone surrogates),
+		/// 64 to a line and with runs of white space in between
+		QStringList lines;
+		for (uint first = 0; first < 0x10000; first += 64)
+		{
+			QString line(" ");
+			for (uint ch = first; ch < first + 64; ++ch)
+			{
+				line.append(QChar(static_cast<ushort>(ch)));
+				if (ch % 7 == 0)
+				{
+					line.append(" \t  ");
+				}
+			}
+			line.append("  ");
+			lines.append(line);
+		}
+
+		lines << ""
+			  << "   "
+			  << "  Hello,  World!  "
+			  << "don't  stop\t\tnow \r"
+			  << "''' ' rock'n'roll"
+			  << QString::fromUtf8("Ærøskøbing  ÉCOLE  naïve")
+			  << QString::fromUtf8("a\xC2\xA0""b \xE2\x80\x83 c\xE3\x80\x80""d\xE2\x80\xA8""e")
+			  << QString::fromUtf8("𝐀𝐁𝐂 x 😀, 𝄞!")
+			  << QString::fromUtf8("İSTANBUL ΣΟΦΙΑ")
+			  << QString::fromUtf8("日本語、テキスト。 123 ٣٤٥");
+
+		/// All combinations of the six preprocessing options
+		for (uint options = 0; options < 64; ++options)
+		{
+			Options::proc_lowercase = (options & 1) != 0;
+			Options::proc_remove_all_spaces = (options & 2) != 0;
+			Options::proc_remove_non_alnum = (options & 4) != 0;
+			Options::proc_remove_punctuation = (options & 8) != 0;
+			Options::proc_keep_apostrophes = (options & 16) != 0;
+			Options::proc_collapse_multiple_spaces = (options & 32) != 0;
+
+			const Preprocessor preprocessor;
+			for (const QString& line : lines)
+			{
+				const QString expected(reference_process_line(line));
+				const QString actual(preprocessor.process_line(line));
+				if (actual != expected)
+				{
+					report("Preprocessor, options " + std::to_string(options), line, expected, actual);
+				}
+			}
+		}
+	}
+
+	///
+	/// \brief Read a file with LineReader and compare each line
+	/// with QString::fromUtf8() of its bytes
+	/// \param _what
+	/// \param _bytes: the contents of the file (without a byte order mark)
+	/// \param _valid: whether the contents are valid UTF-8
+	///
+	void check_line_reader(const std::string& _what,
+						   const QByteArray& _bytes,
+						   const bool _valid)
+	{
+		QTemporaryFile file;
+		if (!file.open()
+			|| file.write(_bytes) != _bytes.size()
+			|| !file.flush())
+		{
+			std::cerr << "Cannot write a temporary file: " << file.errorString().toLocal8Bit().constData() << std::endl;
+			++failures;
+			return;
+		}
+
+		LineReader reader;
+		QString error;
+		if (!reader.open(file.fileName(), error))
+		{
+			std::cerr << "Cannot read " << file.fileName().toLocal8Bit().constData() << ": " << error.toLocal8Bit().constData() << std::endl;
+			++failures;
+			return;
+		}
+
+		if (reader.is_valid() != _valid)
+		{
+			report("LineReader::is_valid(), " + _what, QString::fromUtf8(_bytes), QString(_valid ? "1" : "0"), QString(_valid ? "0" : "1"));
+		}
+
+		/// The lines as QTextStream::readLine() would split them
+		QList<QByteArray> expected_lines(_bytes.split('\n'));
+		if (_bytes.endsWith('\n'))
+		{
+			expected_lines.removeLast();
+		}
+
+		QString line;
+		int line_count(0);
+		while (reader.read_line(line))
+		{
+			if (line_count >= expected_lines.size())
+			{
+				report("LineReader, extra line in " + _what, QString(), QString(), line);
+				break;
+			}
+
+			QByteArray bytes(expected_lines.at(line_count++));
+			if (bytes.endsWith('\r'))
+			{
+				bytes.chop(1);
+			}
+
+			const QString expected(QString::fromUtf8(bytes));
+			if (line != expected)
+			{
+				report("LineReader, line " + std::to_string(line_count) + " of " + _what, QString::fromLatin1(bytes), expected, line);
+			}
+		}
+
+		if (line_count < expected_lines.size())
+		{
+			report("LineReader, missing lines in " + _what, QString(), QString::number(expected_lines.size()), QString::number(line_count));
+		}
+	}
+
+	void check_line_reader()
+	{
+		const std::vector<QByteArray> valid
+		{
+			"plain ASCII text which is longer than eight bytes",
+			"x",
+			"",
+			"na\xC3\xAFve caf\xC3\xA9 \xC3\x86r\xC3\xB8sk\xC3\xB8""bing",
+			"\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E \xE2\x82\xAC\xE2\x88\x91",
+			"\xF0\x9D\x84\x9E music \xF0\x9F\x98\x80\xF0\x9F\x98\x80",
+			"\xEF\xBF\xBD\xEE\x80\x80\xF3\xA0\x80\x81\xF0\x90\x80\x80",
+			"\xC2\x80\xDF\xBF\xE0\xA0\x80\xED\x9F\xBF\xEE\x80\x80",
+			"tab\tseparated\tvalues\r",
+			"1234567\xC3\xA9""89abcdef\xE2\x82\xAC""0123456"
+		};
+
+		const std::vector<QByteArray> invalid
+		{
+			"\x80",
+			"\xBF\xBF",
+			"\xC0\x80",
+			"\xC1\xBF",
+			"\xC3",
+			"\xC3\x28",
+			"\xE0\x80\x80",
+			"\xE0\x9F\xBF",
+			"\xED\xA0\x80",
+			"\xED\xBF\xBF",
+			"\xE6\x97",
+			"\xF0\x8F\xBF\xBF",
+			"\xF0\x9D\x84",
+			"\xF4\x90\x80\x80",
+			"\xF5\x80\x80\x80",
+			"\xF8\x88\x80\x80\x80",
+			"\xFE",
+			"\xFF"
+		};
+
+		/// Valid lines in several orders and with both kinds of line breaks
+		QByteArray all_valid;
+		for (uint round = 0; round < 3; ++round)
+		{
+			for (uint l = 0; l < valid.size(); ++l)
+			{
+				all_valid.append(valid[(l * (round + 1)) % valid.size()]);
+				all_valid.append(l % 2 == 0 ? "\n" : "\r\n");
+			}
+		}
+		check_line_reader("valid text", all_valid, true);
+		check_line_reader("valid text without a final line break", all_valid + valid[3], true);
+
+		/// Everything after the first invalid sequence is decoded differently,
+		/// so each invalid sequence gets a file of its own, with valid lines
+		/// on both sides and in the middle or at the end of a line
+		for (uint i = 0; i < invalid.size(); ++i)
+		{
+			const QByteArray before(all_valid + "abc" + invalid[i] + "def\n");
+			check_line_reader("invalid sequence " + std::to_string(i), before + all_valid, false);
+			check_line_reader("invalid sequence " + std::to_string(i) + " at the end of a line", all_valid + "abc" + invalid[i] + "\n" + all_valid, false);
+			check_line_reader("invalid sequence " + std::to_string(i) + " at the end of the file", all_valid + invalid[i], false);
+		}
+
+		/// Random mixtures (the same every time)
+		std::mt19937 generator(2017);
+		for (uint file = 0; file < 50; ++file)
+		{
+			const bool with_invalid(file % 2 == 1);
+			QByteArray bytes;
+			for (uint l = 0; l < 200; ++l)
+			{
+				const uint pieces(generator() % 8);
+				for (uint p = 0; p < pieces; ++p)
+				{
+					if (with_invalid
+						&& generator() % 50 == 0)
+					{
+						bytes.append(invalid[generator() % invalid.size()]);
+					}
+					else
+					{
+						QByteArray piece(valid[generator() % valid.size()]);
+						if (piece.endsWith('\r'))
+						{
+							piece.chop(1);
+						}
+						bytes.append(piece);
+					}
+				}
+				bytes.append(generator() % 4 == 0 ? "\r\n" : "\n");
+			}
+
+			const bool valid_file(!with_invalid
+								  || QString::fromUtf8(bytes).toUtf8() == bytes);
+			check_line_reader("random file " + std::to_string(file), bytes, valid_file);
+		}
+	}
+}
+
+int main()
+{
+	check_preprocessor();
+	check_line_reader();
+
+	if (failures > 0)
+	{
+		std::cerr << failures << " check(s) failed" << std::endl;
+		return 1;
+	}
+
+	std::cout << "All checks passed" << std::endl;
+	return 0;
+}
@@ -0,0 +1,194 @@
+#include "Globals.hpp"
+#include "Options.hpp"
+#include "Pipeline.hpp"
+#include "ProgressSink.hpp"
+#include "SegmentationServer.hpp"
+#include <QCommandLineParser>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+///
+/// \brief Run the processing stages on a corpus without the GUI.
+///
+/// Usage: morpheus-cli [options] <corpus>
+/// The settings saved by the GUI are used unless they are overridden
+/// on the command line. Messages and progress are written to standard
+/// error and the timing of each stage to standard output as JSON.
+///
+/// With --serve, the process then answers queries about the trained
+/// model on a local socket until it is killed (see SegmentationServer).
+///
+int main(int argc, char *argv[])
+{
+	using namespace Morpheus;
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setOrganizationName("Cantordust");
+	QCoreApplication::setApplicationName("Morpheus");
+
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Extract morphemes from a corpus");
+	parser.addHelpOption();
+	parser.addPositionalArgument("corpus", "The corpus (one sentence per line)");
+
+	QCommandLineOption threads_option("threads", "Number of extraction threads (0 for all cores)", "n");
+	QCommandLineOption max_lines_option("max-lines", "Maximum number of lines to process (0 for all)", "n");
+	QCommandLineOption method_option("method", "Segmentation method: count, entropy or frequency", "method");
+	QCommandLineOption no_resegment_option("no-resegment", "Skip resegmentation");
+	QCommandLineOption model_option("model", "Export the morpheme model to <file>", "file");
+	QCommandLineOption timing_option("timing", "Write the timings to <file> ('-' for standard output)", "file", "-");
+	QCommandLineOption progress_option("progress", "Progress reports: console, json (one object per line) or none", "format", "console");
+	QCommandLineOption quiet_option("quiet", "Do not report progress (same as --progress none)");
+	QCommandLineOption serve_option("serve", "After training, answer queries on the local socket <name>", "name");
+	parser.addOptions({threads_option,
+					   max_lines_option,
+					   method_option,
+					   no_resegment_option,
+					   model_option,
+					   timing_option,
+					   progress_option,
+					   quiet_option,
+					   serve_option});
+
+	parser.process(app);
+
+	if (parser.positionalArguments().size() != 1)
+	{
+		parser.showHelp(1);
+	}
+
+	QSettings s;
+	Options::load(s);
+
+	if (parser.isSet(threads_option))
+	{
+		Options::extraction_threads = parser.value(threads_option).toUInt();
+	}
+
+	if (parser.isSet(max_lines_option))
+	{
+		Options::max_lines = parser.value(max_lines_option).toUInt();
+	}
+
+	if (parser.isSet(method_option))
+	{
+		const QString method(parser.value(method_option));
+		if (method != "count"
+			&& method != "entropy"
+			&& method != "frequency")
+		{
+			std::cerr << "Unknown segmentation method: " << method.toLocal8Bit().constData() << std::endl;
+			return 1;
+		}
+		Options::seg_method_ps_count = (method == "count");
+		Options::seg_method_ps_entropy = (method == "entropy");
+		Options::seg_method_character_frequencies = (method == "frequency");
+	}
+
+	MorphemeExtractor extractor;
+	Pipeline pipeline(extractor);
+
+	auto log = [](const QString& _message)
+	{
+		std::cerr << _message.toLocal8Bit().constData() << std::endl;
+	};
+	QObject::connect(&extractor, &MorphemeExtractor::update_log, log);
+	QObject::connect(&pipeline, &Pipeline::update_log, log);
+
+	/// Progress is written to standard error
+	uptr<ProgressSink> progress;
+	const QString progress_format(parser.isSet(quiet_option) ? "none" : parser.value(progress_option));
+	if (progress_format == "console")
+	{
+		progress = std::make_unique<ConsoleProgress>();
+	}
+	else if (progress_format == "json")
+	{
+		progress = std::make_unique<JsonProgress>();
+	}
+	else if (progress_format == "none")
+	{
+		progress = std::make_unique<NullProgress>();
+	}
+	else
+	{
+		std::cerr << "Unknown progress format: " << progress_format.toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
+	pipeline.set_progress(*progress);
+
+	const QString corpus(parser.positionalArguments().first());
+	if (!pipeline.set_input(corpus))
+	{
+		std::cerr << "Cannot find " << corpus.toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
+
+	/// Each stage runs on this thread, so its results are committed right away
+	bool ok(pipeline.load_corpus()
+			&& pipeline.commit()
+			&& pipeline.extract_morphemes()
+			&& pipeline.commit()
+			&& (parser.isSet(no_resegment_option)
+				|| (pipeline.resegment_morphemes()
+					&& pipeline.commit()))
+			&& pipeline.save_stats());
+
+	if (ok
+		&& parser.isSet(model_option))
+	{
+		ok = extractor.export_model(parser.value(model_option));
+	}
+
+	/// Timings
+	QJsonArray stages;
+	for (const Pipeline::Timing& timing : pipeline.get_timings())
+	{
+		QJsonObject stage;
+		stage["stage"] = timing.stage;
+		stage["seconds"] = timing.seconds;
+		stage["lines"] = static_cast<qint64>(timing.lines);
+		stages.append(stage);
+	}
+
+	QJsonObject report;
+	report["corpus"] = corpus;
+	report["lines"] = static_cast<qint64>(pipeline.get_line_count());
+	report["morphemes"] = static_cast<qint64>(extractor.get_dictionary_size());
+	report["stages"] = stages;
+	const QByteArray json(QJsonDocument(report).toJson());
+
+	QFile timing_file;
+	const QString timing_name(parser.value(timing_option));
+	if (timing_name != "-")
+	{
+		timing_file.setFileName(timing_name);
+	}
+	if (!(timing_name != "-" ? timing_file.open(QIODevice::WriteOnly | QIODevice::Text)
+							 : timing_file.open(stdout, QIODevice::WriteOnly | QIODevice::Text)))
+	{
+		std::cerr << "Cannot write the timings: " << timing_file.errorString().toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
+	timing_file.write(json);
+	timing_file.close();
+
+	if (ok
+		&& parser.isSet(serve_option))
+	{
+		/// Queries are answered from the dictionary trained above
+		SegmentationServer server(extractor);
+		QObject::connect(&server, &SegmentationServer::update_log, log);
+		if (!server.start(parser.value(serve_option), Options::extraction_threads))
+		{
+			std::cerr << "Cannot listen on " << parser.value(serve_option).toLocal8Bit().constData()
+					  << ": " << server.get_error().toLocal8Bit().constData() << std::endl;
+			return 1;
+		}
+
+		return app.exec();
+	}
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+#include "Globals.hpp"
+#include "FrozenModel.hpp"
+#include "ViterbiSegmenter.hpp"
+#include "Preprocessor.hpp"
+
+///
+/// \brief Segment text with a model exported from Morpheus (see FrozenModel).
+/// No corpus or suffix array is loaded.
+///
+/// Usage: morpheus-segment <model> [input] [output]
+/// Standard input and output are used if no files are given.
+/// Each line is preprocessed with the settings stored in the model,
+/// so the input is treated like the training corpus.
+///
+int main(int argc, char *argv[])
+{
+	using namespace Morpheus;
+
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <model> [input] [output]" << std::endl;
+		return 1;
+	}
+
+	FrozenModel model;
+	QString error;
+	if (!model.load(QString::fromLocal8Bit(argv[1]), error))
+	{
+		std::cerr << "Cannot load " << argv[1] << ": " << error.toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
+
+	/// The preprocessing options used for training
+	const std::vector<std::pair<QString, bool*>> proc_options
+	{
+		{"lowercase", &Options::proc_lowercase},
+		{"remove_all_spaces", &Options::proc_remove_all_spaces},
+		{"remove_non_alnum", &Options::proc_remove_non_alnum},
+		{"remove_punctuation", &Options::proc_remove_punctuation},
+		{"collapse_multiple_spaces", &Options::proc_collapse_multiple_spaces},
+		{"keep_apostrophes", &Options::proc_keep_apostrophes}
+	};
+
+	const QList<QPair<QString, QString>> config(model.get_config());
+	for (const std::pair<QString, bool*>& option : proc_options)
+	{
+		bool found(false);
+		for (const QPair<QString, QString>& setting : config)
+		{
+			if (setting.first == option.first)
+			{
+				*option.second = (setting.second.toInt() != 0);
+				found = true;
+				break;
+			}
+		}
+
+		if (!found)
+		{
+			std::cerr << "Cannot apply the preprocessing options: " << argv[1]
+					  << " does not store '" << option.first.toUtf8().constData()
+					  << "'. The input must already be preprocessed." << std::endl;
+			return 1;
+		}
+	}
+
+	QFile input;
+	if (argc > 2)
+	{
+		input.setFileName(QString::fromLocal8Bit(argv[2]));
+	}
+	if (!(argc > 2 ? input.open(QIODevice::ReadOnly | QIODevice::Text)
+				   : input.open(stdin, QIODevice::ReadOnly | QIODevice::Text)))
+	{
+		std::cerr << "Cannot open the input: " << input.errorString().toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
+
+	QFile output;
+	if (argc > 3)
+	{
+		output.setFileName(QString::fromLocal8Bit(argv[3]));
+	}
+	if (!(argc > 3 ? output.open(QIODevice::WriteOnly | QIODevice::Text)
+				   : output.open(stdout, QIODevice::WriteOnly | QIODevice::Text)))
+	{
+		std::cerr << "Cannot open the output: " << output.errorString().toLocal8Bit().constData() << std::endl;
+		return 1;
+	}
+
+	QTextStream in(&input);
+	QTextStream out(&output);
+	in.setCodec("UTF-8");
+	out.setCodec("UTF-8");
+
+	/// Created after the options are set
+	Preprocessor preprocessor;
+	ViterbiSegmenter<FrozenModel> segmenter(model);
+	QString line;
+	while (in.readLineInto(&line))
+	{
+		out << segmenter.segment(preprocessor.process_line(line)) << '\n';
+	}
+
+	return 0;
+}